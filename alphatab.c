@@ -1,5 +1,6 @@
 
 #include "alphatab.h"
+#include "hashtable.h"
 #include <stdio.h>
 
   char*
@@ -107,6 +108,23 @@ cmp_cstr_loc (const char* const* a, const char* const* b)
   return cmp_cstr (*a, *b);
 }
 
+/** Hash which agrees with cmp_AlphaTab().**/
+  uint32_t
+hash_AlphaTab (const AlphaTab* a)
+{
+  zuint n = a->sz;
+  if (n > 0 && !a->s[n-1])  --n;
+  return hash_bytes (a->s, n);
+}
+
+/** Hash which agrees with cmp_cstr_loc().**/
+  uint32_t
+hash_cstr_loc (const char* const* a)
+{
+  if (!*a)  return 0;
+  return hash_bytes (*a, strlen (*a));
+}
+
   void
 cat_uint_AlphaTab (AlphaTab* a, uint x)
 {
@@ -310,6 +310,10 @@ Sign
 cmp_AlphaTab (const AlphaTab* a, const AlphaTab* b);
 Sign
 cmp_cstr_loc (const char* const* a, const char* const* b);
+uint32_t
+hash_AlphaTab (const AlphaTab* a);
+uint32_t
+hash_cstr_loc (const char* const* a);
 void
 cat_uint_AlphaTab (AlphaTab* a, uint x);
 void
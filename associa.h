@@ -6,21 +6,42 @@
 #define Associa_H_
 #include "lgtable.h"
 #include "rbtree.h"
+#include "bptree.h"
+#include "hashtable.h"
 
 typedef struct Assoc Assoc;
 typedef struct Associa Associa;
 
-/** Associative array element (association).**/
+/** Search structure behind an associative array.**/
+enum AssociaKind
+{
+  Associa_RBTree,
+  Associa_BPTree,
+  Associa_Hash
+};
+typedef enum AssociaKind AssociaKind;
+
+/** Associative array element (association).
+ * Outside of a red-black tree, {rbt.red} is one of the marks below,
+ * and {rbt.bst.joint} points to the B+ tree leaf or the hash table
+ * which holds the association.
+ **/
 struct Assoc
 {
     RBTNode rbt;
 };
+#define BPTreeMark_Assoc  2
+#define HashMark_Assoc  3
 
 /** Associative array.**/
 struct Associa
 {
     LgTable nodes;
+    AssociaKind kind;
     RBTree rbt;
+    BPTree bpt;
+    /** On the heap so associations can point to it.**/
+    HashTable* ht;
     size_t key_sz;
     size_t val_sz;
     size_t assoc_offset;
@@ -67,6 +88,68 @@ struct Associa
                         offsetof( Assoc_Tmp, key ), 0);  \
 } while (0)
 
+/** Like InitAssocia(), but keep subtree sizes in the red-black tree.
+ * This allows select_Associa() and rank_Associa().
+ **/
+#define InitRankAssocia( K, V, name, cmp_fn )  do \
+{ \
+  struct Assoc_Tmp \
+  { \
+    Assoc assoc; \
+      K key; \
+      V val; \
+      zuint count; \
+  }; \
+  typedef struct Assoc_Tmp Assoc_Tmp; \
+  name = cons7_Associa ((PosetCmpFn) cmp_fn, \
+                        sizeof(Assoc_Tmp), \
+                        sizeof(K), \
+                        sizeof(V), \
+                        offsetof( Assoc_Tmp, assoc ), \
+                        offsetof( Assoc_Tmp, key ), \
+                        offsetof( Assoc_Tmp, val )); \
+  (name).rbt.count_off = (ptrdiff_t) (offsetof( Assoc_Tmp, count ) - \
+                                      offsetof( Assoc_Tmp, assoc )); \
+} while (0)
+
+/** Like InitAssocia(), but use a B+ tree.
+ * This is faster than the red-black tree for big maps.
+ * \param cmp_kind  \ref BPTreeCmpKind which acts on keys.
+ *   Use BPTreeCmp_Fn to compare with {cmp_fn}.
+ * \param cmp_fn  \ref PosetCmpFn which acts on keys.
+ *   It may be NULL for the other kinds, since the map only compares keys
+ *   through cmp_keys_Associa().
+ **/
+#define InitBPTAssocia( K, V, name, cmp_kind, cmp_fn )  do \
+{ \
+  InitAssocia( K, V, name, cmp_fn ); \
+  bptree_fo_Associa (&(name), cmp_kind); \
+} while (0)
+
+#define InitBPTSet( K, name, cmp_kind, cmp_fn )  do \
+{ \
+  InitSet( K, name, cmp_fn ); \
+  bptree_fo_Associa (&(name), cmp_kind); \
+} while (0)
+
+/** Like InitAssocia(), but use a hash table.
+ * Lookups take constant time, but iteration follows no order.
+ * \param hash_fn  \ref HashFn which acts on keys.
+ * \param cmp_fn  \ref PosetCmpFn which acts on keys.
+ *   Only its equality result is used.
+ **/
+#define InitHashAssocia( K, V, name, hash_fn, cmp_fn )  do \
+{ \
+  InitAssocia( K, V, name, cmp_fn ); \
+  hash_fo_Associa (&(name), (HashFn) hash_fn); \
+} while (0)
+
+#define InitHashSet( K, name, hash_fn, cmp_fn )  do \
+{ \
+  InitSet( K, name, cmp_fn ); \
+  hash_fo_Associa (&(name), (HashFn) hash_fn); \
+} while (0)
+
 
 /** Construct an associative array.
  * Don't use this directly.
@@ -84,6 +167,8 @@ cons7_Associa (PosetCmpFn cmp_fn,
 {
   Associa map;
   map.nodes = dflt1_LgTable (node_sz);
+  map.kind = Associa_RBTree;
+  map.ht = 0;
   map.key_sz       =  key_sz;
   map.val_sz       =  val_sz;
   map.assoc_offset =  assoc_offset;
@@ -97,16 +182,104 @@ cons7_Associa (PosetCmpFn cmp_fn,
     cmp.off = (ptrdiff_t) (key_offset - assoc_offset);
     cmp.fn = cmp_fn;
     map.rbt = dflt2_RBTree (&assoc->rbt, cmp);
+    /* The tree links of an Assoc are unused in a B+ tree,
+     * so they hold its leaf and its index there.
+     */
+    Claim2( sizeof(zuint) ,<=, sizeof(BSTNode*) );
+    map.bpt = dflt5_BPTree (key_sz, offsetof( Assoc, rbt.bst.joint ),
+                            offsetof( Assoc, rbt.bst.split ),
+                            BPTreeCmp_Fn, cmp_fn);
   }
   return map;
 }
 
-/** Free everything.**/
+/** Switch an empty map to use a B+ tree.
+ * \sa InitBPTAssocia()
+ **/
+qual_inline
+  void
+bptree_fo_Associa (Associa* map, BPTreeCmpKind cmp_kind)
+{
+  map->kind = Associa_BPTree;
+  map->bpt.cmpkind = cmp_kind;
+}
+
+/** Switch an empty map to use a hash table.
+ * \sa InitHashAssocia()
+ **/
+qual_inline
+  void
+hash_fo_Associa (Associa* map, HashFn hash_fn)
+{
+  map->kind = Associa_Hash;
+  map->ht = AllocT( HashTable, 1 );
+  *map->ht = dflt3_HashTable ((ptrdiff_t) (map->key_offset - map->assoc_offset),
+                              hash_fn, map->rbt.bst.cmp.fn);
+  /* The tree links of an Assoc are unused in a hash table,
+   * so one of them holds its slot.
+   */
+  Claim2( sizeof(zuint) ,<=, sizeof(BSTNode*) );
+  map->ht->idx_off = (ptrdiff_t) offsetof( Assoc, rbt.bst.split );
+}
+
+/** Construct an empty map with the same layout and search structure
+ * as {map}.
+ **/
+qual_inline
+  Associa
+like_Associa (const Associa* map)
+{
+  Associa a = cons7_Associa (map->rbt.bst.cmp.fn, map->nodes.elsz,
+                             map->key_sz, map->val_sz,
+                             map->assoc_offset,
+                             map->key_offset,
+                             map->val_offset);
+  a.rbt.count_off = map->rbt.count_off;
+  if (map->kind == Associa_BPTree)
+    bptree_fo_Associa (&a, map->bpt.cmpkind);
+  else if (map->kind == Associa_Hash)
+    hash_fo_Associa (&a, map->ht->hash);
+  return a;
+}
+
+/** Free everything.
+ * The association pool is released in whole blocks,
+ * so this does not visit individual associations.
+ **/
 qual_inline
     void
 lose_Associa (Associa* map)
 {
     lose_LgTable (&map->nodes);
+    lose_BPTree (&map->bpt);
+    if (map->ht)
+    {
+        lose_HashTable (map->ht);
+        free (map->ht);
+    }
+}
+
+/** Remove every association.
+ * Like lose_Associa(), this releases the association pool in whole
+ * blocks rather than removing associations one by one,
+ * but the map stays usable.
+ **/
+qual_inline
+  void
+clear_Associa (Associa* map)
+{
+  const TableElSz elsz = map->nodes.elsz;
+  lose_LgTable (&map->nodes);
+  map->nodes = dflt1_LgTable (elsz);
+  {
+    void* node = take_LgTable (&map->nodes);
+    Assoc* assoc = CastOff( Assoc, node ,+, map->assoc_offset );
+    assoc->rbt.red = 0;
+    map->rbt.bst = dflt2_BSTree (&assoc->rbt.bst, map->rbt.bst.cmp);
+  }
+  clear_BPTree (&map->bpt);
+  if (map->ht)
+    clear_HashTable (map->ht);
 }
 
 /** Get the key of an association.**/
@@ -160,6 +333,10 @@ take_Associa (Associa* map)
     void* node = take_LgTable (&map->nodes);
     Assoc* a = CastOff( Assoc, node ,+, map->assoc_offset );
     a->rbt.bst.joint = 0;
+    if (map->kind == Associa_BPTree)
+      a->rbt.red = BPTreeMark_Assoc;
+    else if (map->kind == Associa_Hash)
+      a->rbt.red = HashMark_Assoc;
     return a;
 }
 
@@ -175,8 +352,17 @@ qual_inline
     void
 give_Associa (Associa* map, Assoc* assoc)
 {
-    if (assoc->rbt.bst.joint)
-        remove_RBTree (&map->rbt, &assoc->rbt);
+    if (!assoc->rbt.bst.joint)
+      ;
+    else if (map->kind == Associa_BPTree)
+      remove_BPTree (&map->bpt, assoc);
+    else if (map->kind == Associa_Hash)
+    {
+      remove_HashTable (map->ht, assoc);
+      assoc->rbt.bst.joint = 0;
+    }
+    else
+      remove_RBTree (&map->rbt, &assoc->rbt);
     give_LgTable (&map->nodes, CastOff( void, assoc ,-, map->assoc_offset ));
 }
 
@@ -191,7 +377,17 @@ insert_Associa (Associa* map, const void* key, const void* val)
     Assoc* a = take_Associa (map);
     key_fo_Assoc (map, a, key);
     val_fo_Assoc (map, a, val);
-    insert_RBTree (&map->rbt, &a->rbt);
+    if (map->kind == Associa_BPTree)
+    {
+      insert_BPTree (&map->bpt, key_of_Assoc (map, a), a);
+    }
+    else if (map->kind == Associa_Hash)
+    {
+      insert_HashTable (map->ht, a);
+      a->rbt.bst.joint = (BSTNode*) map->ht;
+    }
+    else
+      insert_RBTree (&map->rbt, &a->rbt);
     return a;
 }
 
@@ -202,8 +398,50 @@ qual_inline
   Assoc*
 lookup_Associa (Associa* map, const void* key)
 {
-  BSTNode* bst = find_BSTree (&map->rbt.bst, key);
+  BSTNode* bst;
+  if (map->kind == Associa_BPTree)
+    return (Assoc*) find_BPTree (&map->bpt, key);
+  if (map->kind == Associa_Hash)
+    return (Assoc*) find_HashTable (map->ht, key);
+
+  bst = find_BSTree (&map->rbt.bst, key);
+  if (!bst)  return 0;
+  return CastUp( Assoc, rbt, CastUp( RBTNode, bst, bst ) );
+}
+
+/** Get the first association whose key is not less than {key}.
+ * Iterate from here with next_Assoc() to visit a range of keys.
+ * The map must be ordered (not a hash table).
+ * \return  NULL when no such association exists.
+ **/
+qual_inline
+  Assoc*
+lower_bound_Associa (Associa* map, const void* key)
+{
+  BSTNode* bst;
+  Claim2( map->kind ,!=, Associa_Hash );
+  if (map->kind == Associa_BPTree)
+    return (Assoc*) lower_bound_BPTree (&map->bpt, key);
+
+  bst = lower_bound_BSTree (&map->rbt.bst, key);
+  if (!bst)  return 0;
+  return CastUp( Assoc, rbt, CastUp( RBTNode, bst, bst ) );
+}
+
+/** Get the first association whose key is greater than {key}.
+ * The map must be ordered (not a hash table).
+ * \return  NULL when no such association exists.
+ **/
+qual_inline
+  Assoc*
+upper_bound_Associa (Associa* map, const void* key)
+{
+  BSTNode* bst;
+  Claim2( map->kind ,!=, Associa_Hash );
+  if (map->kind == Associa_BPTree)
+    return (Assoc*) upper_bound_BPTree (&map->bpt, key);
 
+  bst = upper_bound_BSTree (&map->rbt.bst, key);
   if (!bst)  return 0;
   return CastUp( Assoc, rbt, CastUp( RBTNode, bst, bst ) );
 }
@@ -220,6 +458,17 @@ ensure1_Associa (Associa* map, const void* key, bool* added)
     Assoc* a = 0;
     key_fo_Assoc (map, b, key);
 
+    if (map->kind == Associa_BPTree)
+    {
+        a = (Assoc*) ensure_BPTree (&map->bpt, key_of_Assoc (map, b), b);
+    }
+    else if (map->kind == Associa_Hash)
+    {
+        a = (Assoc*) ensure_HashTable (map->ht, b);
+        if (a == b)
+            a->rbt.bst.joint = (BSTNode*) map->ht;
+    }
+    else
     {
         RBTNode* rbt = ensure_RBTree (&map->rbt, &b->rbt);
         a = CastUp( Assoc, rbt, rbt );
@@ -257,12 +506,171 @@ remove_Associa (Associa* map, const void* key)
 }
 
 
+/** Compare keys {a} and {b} as the map orders them.
+ * The map must be ordered (not a hash table).
+ **/
+qual_inline
+  Sign
+cmp_keys_Associa (const Associa* map, const void* a, const void* b)
+{
+  if (map->kind == Associa_BPTree)
+    return cmp_keys_BPTree (&map->bpt, a, b);
+  return map->rbt.bst.cmp.fn (a, b);
+}
+
+/** Stable merge sort of indices into an array of keys.
+ * Don't use this directly.
+ * \sa bulkload_Associa()
+ **/
+qual_inline
+  void
+sort_idcs_Associa (const Associa* map, zuint* idcs, zuint n,
+                   const void* keys)
+{
+  const size_t elsz = map->key_sz;
+  zuint* buf = AllocT( zuint, n );
+  zuint* src = idcs;
+  zuint* dst = buf;
+  zuint w;
+  for (w = 1; w < n; w *= 2)
+  {
+    zuint lo;
+    for (lo = 0; lo < n; lo += 2*w)
+    {
+      zuint i = lo;
+      zuint j = (lo + w < n) ? lo + w : n;
+      const zuint mid = j;
+      const zuint hi = (lo + 2*w < n) ? lo + 2*w : n;
+      zuint k = lo;
+      while (i < mid && j < hi)
+      {
+        if (0 < cmp_keys_Associa (map, EltZ( keys, src[i], elsz ),
+                                  EltZ( keys, src[j], elsz )))
+          dst[k++] = src[j++];
+        else
+          dst[k++] = src[i++];
+      }
+      while (i < mid)  dst[k++] = src[i++];
+      while (j < hi)   dst[k++] = src[j++];
+    }
+    {
+      zuint* tmp = src;
+      src = dst;
+      dst = tmp;
+    }
+  }
+  if (src != idcs)
+    memcpy (idcs, src, n * sizeof(zuint));
+  if (buf)  free (buf);
+}
+
+/** Insert many associations at once.
+ *
+ * The associations are taken from the map's pool in key order.
+ * When the map is an empty red-black tree, the tree is built directly
+ * in linear time (after sorting) rather than by repeated insertion.
+ * Like ensure_Associa(), this will not cause duplicates.
+ * A key which is already in the map, or which comes earlier in {keys},
+ * keeps the value it was first given.
+ *
+ * \param keys  Array of {n} keys.
+ * \param vals  Array of {n} values, or NULL for a set.
+ * \param sorted  Whether {keys} is already in order.
+ *   It does not matter for a hash table, whose keys are never sorted.
+ **/
+qual_inline
+  void
+bulkload_Associa (Associa* map, const void* keys, const void* vals,
+                  zuint n, bool sorted)
+{
+  zuint* idcs = 0;
+  RBTNode** nodes = 0;
+  const bool build = (map->kind == Associa_RBTree &&
+                      !root_of_BSTree (&map->rbt.bst));
+  const void* last_key = 0;
+  zuint m = 0;
+  zuint i;
+
+  if (n == 0)  return;
+  /* A hash table has no order, and its {cmp_fn} may only tell equality.*/
+  if (!sorted && map->kind != Associa_Hash)
+  {
+    idcs = AllocT( zuint, n );
+    UFor( i, n )  idcs[i] = i;
+    sort_idcs_Associa (map, idcs, n, keys);
+  }
+  if (build)
+    nodes = AllocT( RBTNode*, n );
+
+  UFor( i, n )
+  {
+    const zuint j = idcs ? idcs[i] : i;
+    const void* key = EltZ( keys, j, map->key_sz );
+    const void* val = vals ? EltZ( vals, j, map->val_sz ) : 0;
+
+    if (build)
+    {
+      /* Duplicates are adjacent once sorted, and the sort is stable.*/
+      Assoc* a;
+      if (last_key && 0 == cmp_keys_Associa (map, last_key, key))
+        continue;
+      last_key = key;
+      a = take_Associa (map);
+      key_fo_Assoc (map, a, key);
+      if (val)  val_fo_Assoc (map, a, val);
+      nodes[m++] = &a->rbt;
+    }
+    else
+    {
+      bool added = false;
+      Assoc* a = ensure1_Associa (map, key, &added);
+      if (added && val)  val_fo_Assoc (map, a, val);
+    }
+  }
+
+  if (build)
+  {
+    bulkload_RBTree (&map->rbt, nodes, m);
+    free (nodes);
+  }
+  if (idcs)  free (idcs);
+}
+
+
+/** Get the association with {k} associations before it.
+ * The map must be made by InitRankAssocia().
+ * \return  NULL when the map has no more than {k} associations.
+ **/
+qual_inline
+  Assoc*
+select_Associa (Associa* map, zuint k)
+{
+  RBTNode* x = select_RBTree (&map->rbt, k);
+  if (!x)  return 0;
+  return CastUp( Assoc, rbt, x );
+}
+
+/** Count the associations before {a}.
+ * The map must be made by InitRankAssocia().
+ **/
+qual_inline
+  zuint
+rank_Associa (const Associa* map, Assoc* a)
+{
+  return rank_RBTree (&map->rbt, &a->rbt);
+}
+
 /** Get the first association in the map.**/
 qual_inline
     Assoc*
 beg_Associa (Associa* map)
 {
-    BSTNode* bst = beg_BSTree (&map->rbt.bst);
+    BSTNode* bst;
+    if (map->kind == Associa_BPTree)
+        return (Assoc*) beg_BPTree (&map->bpt);
+    if (map->kind == Associa_Hash)
+        return (Assoc*) beg_HashTable (map->ht);
+    bst = beg_BSTree (&map->rbt.bst);
     if (!bst)  return 0;
     return CastUp( Assoc, rbt, CastUp( RBTNode, bst, bst ) );
 }
@@ -272,11 +680,86 @@ qual_inline
     Assoc*
 next_Assoc (Assoc* a)
 {
-    BSTNode* bst = next_BSTNode (&a->rbt.bst);
+    BSTNode* bst;
+    if (a->rbt.red == BPTreeMark_Assoc) {
+        zuint i;
+        memcpy (&i, &a->rbt.bst.split[0], sizeof(i));
+        return (Assoc*) next_BPTNode ((BPTNode*) a->rbt.bst.joint, i);
+    }
+    if (a->rbt.red == HashMark_Assoc)
+        return (Assoc*) next_HashTable ((HashTable*) a->rbt.bst.joint, a);
+    bst = next_BSTNode (&a->rbt.bst);
     if (!bst)  return 0;
     return CastUp( Assoc, rbt, CastUp( RBTNode, bst, bst ) );
 }
 
+/** Give back a node which was cut out of the tree.
+ * Don't use this directly.
+ * \sa remove_range_Associa()
+ **/
+qual_inline
+  void
+give_cut_Associa (BSTNode* x, void* dat)
+{
+  Associa* map = (Associa*) dat;
+  Assoc* a = CastUp( Assoc, rbt, CastUp( RBTNode, bst, x ) );
+  give_LgTable (&map->nodes, CastOff( void, a ,-, map->assoc_offset ));
+}
+
+/** Remove every association whose key is at least {lo} and less than {hi}.
+ *
+ * For a red-black tree, the range is split off and the rest joined back
+ * in O(log n) time, so only the removed associations cost anything more.
+ * A B+ tree removes them one by one from the lower bound.
+ * The map must be ordered (not a hash table).
+ *
+ * \return  Number of associations removed.
+ **/
+qual_inline
+  zuint
+remove_range_Associa (Associa* map, const void* lo, const void* hi)
+{
+  zuint n = 0;
+  Claim2( map->kind ,!=, Associa_Hash );
+
+  if (map->kind == Associa_BPTree)
+  {
+    Assoc* a = lower_bound_Associa (map, lo);
+    while (a && 0 > cmp_keys_Associa (map, key_of_Assoc (map, a), hi))
+    {
+      Assoc* b = next_Assoc (a);
+      give_Associa (map, a);
+      a = b;
+      ++n;
+    }
+  }
+  else
+  {
+    RBTNode sentinels[2];
+    RBTree mid = map->rbt;
+    RBTree top = map->rbt;
+    mid.bst = dflt2_BSTree (&sentinels[0].bst, map->rbt.bst.cmp);
+    top.bst = dflt2_BSTree (&sentinels[1].bst, map->rbt.bst.cmp);
+    sentinels[0].red = 0;
+    sentinels[1].red = 0;
+
+    split_RBTree (&map->rbt, lo, &mid);
+    split_RBTree (&mid, hi, &top);
+    join_RBTree (&map->rbt, &top);
+    if (mid.count_off != 0)
+    {
+      n = sz_of_RBTree (&mid);
+    }
+    else
+    {
+      BSTNode* x = beg_BSTree (&mid.bst);
+      for (; x; x = next_BSTNode (x))
+        ++n;
+    }
+    walk_BSTree (&mid.bst, Yes, give_cut_Associa, map);
+  }
+  return n;
+}
 
 #endif
 
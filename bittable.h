@@ -79,6 +79,38 @@ lsb_BitTableEl (BitTableEl x)
   return (x & (~x + 1));
 }
 
+/** Number of 1 bits.**/
+qual_inline
+  uint
+popcount_BitTableEl (BitTableEl x)
+{
+#ifdef __GNUC__
+  return __builtin_popcount (x);
+#else
+  uint n = 0;
+  for (; x != 0; x &= x - 1)
+    ++n;
+  return n;
+#endif
+}
+
+/** Index of the least significant 1 bit.
+ * The result is undefined when {x} is zero.
+ **/
+qual_inline
+  uint
+lsbidx_BitTableEl (BitTableEl x)
+{
+#ifdef __GNUC__
+  return __builtin_ctz (x);
+#else
+  uint n = 0;
+  for (; (x & 1) == 0; x >>= 1)
+    ++n;
+  return n;
+#endif
+}
+
 /** Floor of the lg (log base 2) of some integer.
  * - 0..1 -> 0
  * - 2..3 -> 1
@@ -296,6 +328,87 @@ setb_BitTable (BitTable bt, zuint i, Bit b)
     return (b ? set1_BitTable (bt, i) : set0_BitTable (bt, i));
 }
 
+#ifdef __GNUC__
+#define AtomicLoad_BitTableEl( p )  __atomic_load_n (p, __ATOMIC_ACQUIRE)
+#define AtomicOr_BitTableEl( p, x )  __atomic_fetch_or (p, x, __ATOMIC_ACQ_REL)
+#define AtomicAnd_BitTableEl( p, x )  __atomic_fetch_and (p, x, __ATOMIC_ACQ_REL)
+#else
+/* Without compiler support, these are only safe within one thread.*/
+#define AtomicLoad_BitTableEl( p )  (*(p))
+#define AtomicOr_BitTableEl( p, x )  fetch_or_BitTableEl (p, x)
+#define AtomicAnd_BitTableEl( p, x )  fetch_and_BitTableEl (p, x)
+qual_inline
+  BitTableEl
+fetch_or_BitTableEl (BitTableEl* p, BitTableEl x)
+{
+  const BitTableEl y = *p;
+  *p = y | x;
+  return y;
+}
+qual_inline
+  BitTableEl
+fetch_and_BitTableEl (BitTableEl* p, BitTableEl x)
+{
+  const BitTableEl y = *p;
+  *p = y & x;
+  return y;
+}
+#endif
+
+/** Check if a bit is set (to one).
+ * Safe to call while other threads modify the table
+ * with atomic_set1_BitTable() and friends.
+ **/
+qual_inline
+  Bit
+atomic_ck_BitTable (const BitTable bt, zuint i)
+{
+  DeclBitTableIdcs( p, q, i );
+  return (0 != (AtomicLoad_BitTableEl( &bt.s[p] ) & ((BitTableEl)1 << q)));
+}
+
+/** Atomically set a bit to one.
+ * \return The previous value of the bit.
+ * Exactly one of several threads setting the same bit sees a 0 returned,
+ * so this can claim states in a shared visited set.
+ **/
+qual_inline
+  Bit
+atomic_set1_BitTable (BitTable bt, zuint i)
+{
+  DeclBitTableIdcs( p, q, i );
+  const BitTableEl y = (BitTableEl)1 << q;
+  /* Avoid dirtying the cache line when the bit is already set.*/
+  if (0 != (AtomicLoad_BitTableEl( &bt.s[p] ) & y))
+    return 1;
+  return (0 != (AtomicOr_BitTableEl( &bt.s[p], y ) & y));
+}
+
+/** Atomically set a bit to zero.
+ * \return The previous value of the bit.
+ **/
+qual_inline
+  Bit
+atomic_set0_BitTable (BitTable bt, zuint i)
+{
+  DeclBitTableIdcs( p, q, i );
+  const BitTableEl y = (BitTableEl)1 << q;
+  if (0 == (AtomicLoad_BitTableEl( &bt.s[p] ) & y))
+    return 0;
+  return (0 != (AtomicAnd_BitTableEl( &bt.s[p], ~y ) & y));
+}
+
+/** Atomically set a bit.
+ * \sa atomic_set0_BitTable()
+ * \sa atomic_set1_BitTable()
+ **/
+qual_inline
+  Bit
+atomic_setb_BitTable (BitTable bt, zuint i, Bit b)
+{
+  return (b ? atomic_set1_BitTable (bt, i) : atomic_set0_BitTable (bt, i));
+}
+
 /** Set a bit to one.**/
 qual_inline
   void
@@ -351,25 +464,24 @@ get_uint_BitTable (BitTable bt, const zuint i, const uint nbits)
 #define Do_BitOp_OR(a,b)  ((a) | (b))
 #define Do_BitOp_YES(a,b)  (1)
 
+/** Apply {op} to the words {a[0..n-1]} and {b[0..n-1]}, storing into {c}.
+ * Any of the arrays may alias each other.
+ **/
 qual_inline
   void
-op2_BitTable (BitTable* c, BitOp op, const BitTable a, const BitTable b)
+op2_BitTableEl (BitTableEl* c, BitOp op,
+                const BitTableEl* a, const BitTableEl* b, zuint n)
 {
   zuint i;
-  const zuint n = CeilQuot( a.sz, NBits_BitTableEl );
-
-  Claim2( a.sz ,==, b.sz );
-  size_fo_BitTable (c, a.sz);
-
 #define DoCase( OP ) \
   case BitOp_##OP: \
-    UFor( i, n )  c->s[i] = Do_BitOp_##OP( a.s[i], b.s[i] ); \
+    UFor( i, n )  c[i] = Do_BitOp_##OP( a[i], b[i] ); \
     break
 
   switch (op)
   {
   case BitOp_NIL:
-    wipe_BitTable (*c, 0);
+    memset (c, 0x00, n * sizeof (BitTableEl));
     break;
   DoCase( NOR );
   DoCase( NOT1 );
@@ -380,15 +492,15 @@ op2_BitTable (BitTable* c, BitOp op, const BitTable a, const BitTable b)
   DoCase( AND );
   DoCase( XNOR );
   case BitOp_IDEN1:
-    if (c->s != b.s)  memcpy (c->s, b.s, n * sizeof (BitTableEl));
+    if (c != b)  memcpy (c, b, n * sizeof (BitTableEl));
     break;
   DoCase( IMP );
   case BitOp_IDEN0:
-    if (c->s != a.s)  memcpy (c->s, a.s, n * sizeof (BitTableEl));
+    if (c != a)  memcpy (c, a, n * sizeof (BitTableEl));
     break;
   DoCase( OR );
   case BitOp_YES:
-    wipe_BitTable (a, 1);
+    memset (c, 0xFF, n * sizeof (BitTableEl));
     break;
   case NBitOps:
     Claim(0);
@@ -398,6 +510,48 @@ op2_BitTable (BitTable* c, BitOp op, const BitTable a, const BitTable b)
 #undef DoCase
 }
 
+qual_inline
+  void
+op2_BitTable (BitTable* c, BitOp op, const BitTable a, const BitTable b)
+{
+  const zuint n = CeilQuot( a.sz, NBits_BitTableEl );
+  Claim2( a.sz ,==, b.sz );
+  size_fo_BitTable (c, a.sz);
+  op2_BitTableEl (c->s, op, a.s, b.s, n);
+}
+
+/** Number of words each thread handles at a time in the par_*_BitTable()
+ * functions. It is big enough that threads rarely share a cache line.
+ **/
+#define ParChunk_BitTable  4096
+
+/** Like op2_BitTable(), but split across threads.
+ * The word range is partitioned into chunks which an OpenMP thread team
+ * handles in parallel. Without OpenMP, this runs serially.
+ **/
+qual_inline
+  void
+par_op2_BitTable (BitTable* c, BitOp op, const BitTable a, const BitTable b)
+{
+  const zuint n = CeilQuot( a.sz, NBits_BitTableEl );
+  const zuint nchunks = CeilQuot( n, ParChunk_BitTable );
+  long i;
+  Claim2( a.sz ,==, b.sz );
+  size_fo_BitTable (c, a.sz);
+  if (nchunks <= 1) {
+    op2_BitTableEl (c->s, op, a.s, b.s, n);
+    return;
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (i = 0; i < (long) nchunks; ++i) {
+    const zuint off = (zuint) i * ParChunk_BitTable;
+    const zuint m = (n - off < ParChunk_BitTable) ? n - off : ParChunk_BitTable;
+    op2_BitTableEl (&c->s[off], op, &a.s[off], &b.s[off], m);
+  }
+}
+
 qual_inline
   void
 op_BitTable (BitTable a, BitOp op, const BitTable b)
@@ -586,15 +740,51 @@ beg_BitTable (const BitTable bt)
   return next_BitTable (bt, 0);
 }
 
+/** Number of 1 bits in the words {s[0..n-1]}.**/
+qual_inline
+  zuint
+count_BitTableEl (const BitTableEl* s, zuint n)
+{
+  zuint c = 0;
+  {zuint i = 0;for (; i < n; ++i)
+    c += popcount_BitTableEl (s[i]);}
+  return c;
+}
+
 qual_inline
   zuint
 count_BitTable (const BitTable bt)
 {
+  const zuint p = bt.sz / NBits_BitTableEl;
+  const uint q = bt.sz % NBits_BitTableEl;
+  zuint n = count_BitTableEl (bt.s, p);
+  if (q > 0)
+    n += popcount_BitTableEl (LowBits(bt.s[p], q));
+  return n;
+}
+
+/** Like count_BitTable(), but split across threads.
+ * \sa par_op2_BitTable()
+ **/
+qual_inline
+  zuint
+par_count_BitTable (const BitTable bt)
+{
+  const zuint p = bt.sz / NBits_BitTableEl;
+  const uint q = bt.sz % NBits_BitTableEl;
+  const zuint nchunks = CeilQuot( p, ParChunk_BitTable );
   zuint n = 0;
-  {zuint i = begidx_BitTable (bt);for (;
-       i < bt.sz;
-       i = nextidx_BitTable (bt, i))
-    ++n;}
+  long i;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+:n)
+#endif
+  for (i = 0; i < (long) nchunks; ++i) {
+    const zuint off = (zuint) i * ParChunk_BitTable;
+    const zuint m = (p - off < ParChunk_BitTable) ? p - off : ParChunk_BitTable;
+    n += count_BitTableEl (&bt.s[off], m);
+  }
+  if (q > 0)
+    n += popcount_BitTableEl (LowBits(bt.s[p], q));
   return n;
 }
 
@@ -0,0 +1,514 @@
+/**
+ * \file bptree.c
+ * B+ tree.
+ *
+ * Internal nodes hold {sz} children and {sz} keys, where key 0 is unused
+ * and key {i} bounds the keys of child {i-1} from above and the keys of
+ * child {i} from below. Removal is lazy: nodes are never merged, but any
+ * node which becomes empty is unlinked and freed.
+ **/
+#include "bptree.h"
+
+/** Offset of the pointer array within a node.**/
+#define PtrsOff  (CeilQuot( sizeof(BPTNode), sizeof(void*) ) * sizeof(void*))
+
+static
+  void**
+ptrs_of (const BPTNode* x)
+{
+  return CastOff( void*, x ,+, PtrsOff );
+}
+
+static
+  byte*
+keys_of (const BPTree* t, const BPTNode* x)
+{
+  return CastOff( byte, x ,+, PtrsOff + t->cap * sizeof(void*) );
+}
+
+static
+  void*
+key_of (const BPTree* t, const BPTNode* x, uint i)
+{
+  return &keys_of (t, x)[i * t->key_sz];
+}
+
+static
+  void
+link_fo (const BPTree* t, void* p, BPTNode* x)
+{
+  *CastOff( BPTNode*, p ,+, t->link_off ) = x;
+}
+
+/** Record where the entries of {x} from index {i} onward now live.**/
+static
+  void
+reindex (const BPTree* t, BPTNode* x, uint i)
+{
+  void** ptrs = ptrs_of (x);
+  if (x->leaf) {
+    for (; i < x->sz; ++i) {
+      const zuint idx = i;
+      memcpy (CastOff( void, ptrs[i] ,+, t->idx_off ), &idx, sizeof(idx));
+    }
+  }
+  else {
+    for (; i < x->sz; ++i)
+      ((BPTNode*) ptrs[i])->idx = i;
+  }
+}
+
+static
+  Sign
+cmp_key (const BPTree* t, const void* a, const void* b)
+{
+#define DoCase( K, T ) \
+  case BPTreeCmp_##K: \
+    { \
+      const T x = *(const T*) a; \
+      const T y = *(const T*) b; \
+      return (x < y) ? -1 : (x > y) ? 1 : 0; \
+    }
+
+  switch (t->cmpkind)
+  {
+  DoCase( int, int );
+  DoCase( uint, uint );
+  DoCase( zuint, zuint );
+  DoCase( MemLoc, uintptr_t );
+  case BPTreeCmp_Fn:
+    break;
+  }
+#undef DoCase
+  return t->cmp_fn (a, b);
+}
+
+/** Compare keys {a} and {b} as the tree orders them.**/
+  Sign
+cmp_keys_BPTree (const BPTree* t, const void* a, const void* b)
+{
+  return cmp_key (t, a, b);
+}
+
+/** Index of the first key of {x} at or after index {lo}
+ * which is not less than {key}, or greater than {key} when {upper} is set.
+ **/
+static
+  uint
+bidx (const BPTree* t, const BPTNode* x, uint lo, const void* key, Bit upper)
+{
+  const byte* keys = keys_of (t, x);
+  uint hi = x->sz;
+
+#define BSearch( lt ) \
+  while (lo < hi) { \
+    const uint mid = lo + (hi - lo) / 2; \
+    if (lt)  lo = mid + 1; \
+    else     hi = mid; \
+  }
+
+#define DoCase( K, T ) \
+  case BPTreeCmp_##K: \
+    { \
+      const T y = *(const T*) key; \
+      if (upper) { \
+        BSearch( ((const T*) keys)[mid] <= y ); \
+      } \
+      else { \
+        BSearch( ((const T*) keys)[mid] < y ); \
+      } \
+    } \
+    break
+
+  switch (t->cmpkind)
+  {
+  DoCase( int, int );
+  DoCase( uint, uint );
+  DoCase( zuint, zuint );
+  DoCase( MemLoc, uintptr_t );
+  case BPTreeCmp_Fn:
+    {
+      const Sign bound = upper ? 1 : 0;
+      BSearch( t->cmp_fn (&keys[mid * t->key_sz], key) < bound );
+    }
+    break;
+  }
+#undef DoCase
+#undef BSearch
+  return lo;
+}
+
+/** Find the leaf and index of the first key not less than {key}
+ * (or greater than {key} when {upper} is set).
+ * The index may be one past the end of the leaf.
+ **/
+static
+  BPTNode*
+bleaf (const BPTree* t, const void* key, uint* ret_idx, Bit upper)
+{
+  BPTNode* x = t->root;
+  while (!x->leaf)
+    x = (BPTNode*) ptrs_of (x)[bidx (t, x, 1, key, upper) - 1];
+  *ret_idx = bidx (t, x, 0, key, upper);
+  return x;
+}
+
+static
+  BPTNode*
+lbleaf (const BPTree* t, const void* key, uint* ret_idx)
+{
+  return bleaf (t, key, ret_idx, 0);
+}
+
+/** Index of child {x} in its parent.**/
+static
+  uint
+idx_of_child (const BPTNode* x)
+{
+  Claim2( x->idx ,<, x->joint->sz );
+  Claim( ptrs_of (x->joint)[x->idx] == x );
+  return x->idx;
+}
+
+/** Index of payload {p} in leaf {x}.**/
+static
+  uint
+idx_of_payload (const BPTree* t, const BPTNode* x, const void* p)
+{
+  const zuint i = idx_of_BPTree (t, p);
+  Claim2( i ,<, x->sz );
+  Claim( ptrs_of (x)[i] == p );
+  return (uint) i;
+}
+
+static
+  BPTNode*
+take_node (BPTree* t, Bit leaf)
+{
+  BPTNode* x = (BPTNode*) take_LgTable (&t->nodes);
+  x->joint = 0;
+  x->prev = 0;
+  x->next = 0;
+  x->idx = 0;
+  x->sz = 0;
+  x->leaf = leaf;
+  return x;
+}
+
+/** Make room at index {i} of node {x}.**/
+static
+  void
+open_entry (const BPTree* t, BPTNode* x, uint i)
+{
+  void** ptrs = ptrs_of (x);
+  memmove (&ptrs[i+1], &ptrs[i], (x->sz - i) * sizeof(void*));
+  memmove (key_of (t, x, i+1), key_of (t, x, i), (x->sz - i) * t->key_sz);
+  ++ x->sz;
+}
+
+/** Remove index {i} of node {x}.**/
+static
+  void
+close_entry (const BPTree* t, BPTNode* x, uint i)
+{
+  void** ptrs = ptrs_of (x);
+  -- x->sz;
+  memmove (&ptrs[i], &ptrs[i+1], (x->sz - i) * sizeof(void*));
+  memmove (key_of (t, x, i), key_of (t, x, i+1), (x->sz - i) * t->key_sz);
+}
+
+/** Move the upper half of {x} into a new node.**/
+static
+  BPTNode*
+split_node (BPTree* t, BPTNode* x)
+{
+  BPTNode* y = take_node (t, x->leaf);
+  const uint h = x->sz / 2;
+  void** ptrs = ptrs_of (y);
+
+  y->sz = x->sz - h;
+  memcpy (ptrs, &ptrs_of (x)[h], y->sz * sizeof(void*));
+  memcpy (key_of (t, y, 0), key_of (t, x, h), y->sz * t->key_sz);
+  x->sz = h;
+
+  if (x->leaf) {
+    y->prev = x;
+    y->next = x->next;
+    if (y->next)  y->next->prev = y;
+    x->next = y;
+    {uint i = 0;for (; i < y->sz; ++i)
+      link_fo (t, ptrs[i], y);}
+  }
+  else {
+    {uint i = 0;for (; i < y->sz; ++i)
+      ((BPTNode*) ptrs[i])->joint = y;}
+  }
+  reindex (t, y, 0);
+  return y;
+}
+
+/** Add {y} as a child just after {x}, with {key} as the separator.**/
+static
+  void
+insert_child (BPTree* t, BPTNode* x, const void* key, BPTNode* y)
+{
+  BPTNode* a = x->joint;
+  uint i;
+
+  if (!a) {
+    a = take_node (t, 0);
+    a->sz = 1;
+    ptrs_of (a)[0] = x;
+    x->joint = a;
+    x->idx = 0;
+    t->root = a;
+  }
+
+  i = 1 + idx_of_child (x);
+  if (a->sz == t->cap) {
+    BPTNode* b = split_node (t, a);
+    insert_child (t, a, key_of (t, b, 0), b);
+    if (i > a->sz) {
+      i -= a->sz;
+      a = b;
+    }
+  }
+
+  open_entry (t, a, i);
+  ptrs_of (a)[i] = y;
+  memcpy (key_of (t, a, i), key, t->key_sz);
+  y->joint = a;
+  reindex (t, a, i);
+}
+
+/** Insert at index {i} of leaf {x}.**/
+static
+  void
+insert_at (BPTree* t, BPTNode* x, uint i, const void* key, void* p)
+{
+  if (x->sz == t->cap) {
+    BPTNode* y = split_node (t, x);
+    insert_child (t, x, key_of (t, y, 0), y);
+    if (i > x->sz) {
+      i -= x->sz;
+      x = y;
+    }
+  }
+  open_entry (t, x, i);
+  ptrs_of (x)[i] = p;
+  memcpy (key_of (t, x, i), key, t->key_sz);
+  link_fo (t, p, x);
+  reindex (t, x, i);
+}
+
+/** Unlink and free an empty node, along with any ancestors
+ * which become empty as a result.
+ **/
+static
+  void
+remove_node (BPTree* t, BPTNode* x)
+{
+  BPTNode* a = x->joint;
+  const uint i = a ? idx_of_child (x) : 0;
+
+  if (x->leaf) {
+    if (x->prev)  x->prev->next = x->next;
+    if (x->next)  x->next->prev = x->prev;
+  }
+  give_LgTable (&t->nodes, x);
+
+  if (!a) {
+    t->root = 0;
+    return;
+  }
+
+  close_entry (t, a, i);
+  reindex (t, a, i);
+  if (a->sz == 0) {
+    remove_node (t, a);
+    return;
+  }
+
+  /* Shorten the tree when the root has a single child.*/
+  while (t->root->sz == 1 && !t->root->leaf) {
+    BPTNode* y = (BPTNode*) ptrs_of (t->root)[0];
+    give_LgTable (&t->nodes, t->root);
+    y->joint = 0;
+    t->root = y;
+  }
+}
+
+  BPTree
+dflt5_BPTree (size_t key_sz, ptrdiff_t link_off, ptrdiff_t idx_off,
+              BPTreeCmpKind cmpkind, PosetCmpFn cmp_fn)
+{
+  BPTree t;
+  zuint node_sz;
+  t.root = 0;
+  t.key_sz = key_sz;
+  t.link_off = link_off;
+  t.idx_off = idx_off;
+  t.cmpkind = cmpkind;
+  t.cmp_fn = cmp_fn;
+
+  t.cap = (NBytes_BPTNode - PtrsOff) / (key_sz + sizeof(void*));
+  if (t.cap < 4)
+    t.cap = 4;
+
+  node_sz = PtrsOff + t.cap * (key_sz + sizeof(void*));
+  node_sz = CeilQuot( node_sz, sizeof(void*) ) * sizeof(void*);
+  t.nodes = dflt1_LgTable (node_sz);
+  return t;
+}
+
+  void
+lose_BPTree (BPTree* t)
+{
+  lose_LgTable (&t->nodes);
+}
+
+/** Remove everything by releasing the node pool wholesale.
+ * Payloads are left alone.
+ **/
+  void
+clear_BPTree (BPTree* t)
+{
+  const TableElSz elsz = t->nodes.elsz;
+  lose_LgTable (&t->nodes);
+  t->nodes = dflt1_LgTable (elsz);
+  t->root = 0;
+}
+
+/** Find a payload whose key matches {key}.
+ * \return  NULL when no such payload exists.
+ **/
+  void*
+find_BPTree (const BPTree* t, const void* key)
+{
+  BPTNode* x;
+  uint i;
+  if (!t->root)  return 0;
+
+  x = lbleaf (t, key, &i);
+  if (i == x->sz) {
+    x = x->next;
+    i = 0;
+    if (!x)  return 0;
+  }
+  if (0 != cmp_key (t, key_of (t, x, i), key))
+    return 0;
+  return ptrs_of (x)[i];
+}
+
+/** Insert payload {p} with a copy of {key}.
+ * This can form duplicates.
+ **/
+  void
+insert_BPTree (BPTree* t, const void* key, void* p)
+{
+  BPTNode* x;
+  uint i = 0;
+  if (!t->root) {
+    x = take_node (t, 1);
+    t->root = x;
+  }
+  else {
+    x = lbleaf (t, key, &i);
+  }
+  insert_at (t, x, i, key, p);
+}
+
+/** If a payload matching {key} exists, return it.
+ * Otherwise, insert {p} and return it.
+ **/
+  void*
+ensure_BPTree (BPTree* t, const void* key, void* p)
+{
+  BPTNode* x;
+  uint i;
+  if (!t->root) {
+    insert_BPTree (t, key, p);
+    return p;
+  }
+
+  x = lbleaf (t, key, &i);
+  if (i < x->sz) {
+    if (0 == cmp_key (t, key_of (t, x, i), key))
+      return ptrs_of (x)[i];
+  }
+  else if (x->next) {
+    if (0 == cmp_key (t, key_of (t, x->next, 0), key))
+      return ptrs_of (x->next)[0];
+  }
+  insert_at (t, x, i, key, p);
+  return p;
+}
+
+/** Remove payload {p} from the tree.**/
+  void
+remove_BPTree (BPTree* t, void* p)
+{
+  BPTNode* x = leaf_of_BPTree (t, p);
+  const uint i = idx_of_payload (t, x, p);
+  close_entry (t, x, i);
+  reindex (t, x, i);
+  link_fo (t, p, 0);
+  if (x->sz == 0)
+    remove_node (t, x);
+}
+
+/** Get the payload with the least key.**/
+  void*
+beg_BPTree (const BPTree* t)
+{
+  BPTNode* x = t->root;
+  if (!x)  return 0;
+  while (!x->leaf)
+    x = (BPTNode*) ptrs_of (x)[0];
+  return ptrs_of (x)[0];
+}
+
+/** Get the payload after index {i} of leaf {x}.
+ * A payload's leaf and index come from leaf_of_BPTree()
+ * and idx_of_BPTree().
+ **/
+  void*
+next_BPTNode (const BPTNode* x, zuint i)
+{
+  Claim2( i ,<, x->sz );
+  i += 1;
+  if (i < x->sz)
+    return ptrs_of (x)[i];
+  if (x->next)
+    return ptrs_of (x->next)[0];
+  return 0;
+}
+
+static
+  void*
+bound_BPTree (const BPTree* t, const void* key, Bit upper)
+{
+  BPTNode* x;
+  uint i;
+  if (!t->root)  return 0;
+  x = bleaf (t, key, &i, upper);
+  if (i < x->sz)
+    return ptrs_of (x)[i];
+  if (x->next)
+    return ptrs_of (x->next)[0];
+  return 0;
+}
+
+/** Get the first payload whose key is not less than {key}.**/
+  void*
+lower_bound_BPTree (const BPTree* t, const void* key)
+{
+  return bound_BPTree (t, key, 0);
+}
+
+/** Get the first payload whose key is greater than {key}.**/
+  void*
+upper_bound_BPTree (const BPTree* t, const void* key)
+{
+  return bound_BPTree (t, key, 1);
+}
@@ -0,0 +1,108 @@
+/**
+ * \file bptree.h
+ * B+ tree.
+ *
+ * Nodes are wide and keep their keys contiguous, so a search touches
+ * one or two cache lines per level rather than one per key.
+ * Each leaf entry pairs a copy of a key with a pointer to some payload
+ * owned by the caller. The payload holds a backlink to its leaf
+ * (at {link_off} bytes into it) and its index in that leaf
+ * (a zuint at {idx_off} bytes into it), which the tree keeps current.
+ * So stepping from a payload to the next one need not search its leaf.
+ **/
+#ifndef BPTree_H_
+#define BPTree_H_
+#include "lgtable.h"
+
+typedef struct BPTNode BPTNode;
+typedef struct BPTree BPTree;
+
+/** Approximate number of bytes in a node.**/
+#define NBytes_BPTNode 512
+
+/** How keys are compared.
+ * The specialized kinds avoid an indirect call per comparison.
+ **/
+enum BPTreeCmpKind
+{
+  BPTreeCmp_Fn,
+  BPTreeCmp_int,
+  BPTreeCmp_uint,
+  BPTreeCmp_zuint,
+  /** Keys are pointers, compared by address.**/
+  BPTreeCmp_MemLoc
+};
+typedef enum BPTreeCmpKind BPTreeCmpKind;
+
+/** Node header.
+ * It is followed by an array of {cap} pointers (children or payloads)
+ * and then an array of {cap} keys.
+ **/
+struct BPTNode
+{
+  BPTNode* joint;  /**< Parent, or NULL at the root.**/
+  BPTNode* prev;  /**< Previous leaf (leaves only).**/
+  BPTNode* next;  /**< Next leaf (leaves only).**/
+  uint idx;  /**< Index in {joint}.**/
+  uint sz;
+  Bit leaf;
+};
+
+struct BPTree
+{
+  LgTable nodes;
+  BPTNode* root;
+  size_t key_sz;
+  uint cap;  /**< Maximum number of entries in a node.**/
+  ptrdiff_t link_off;
+  ptrdiff_t idx_off;
+  BPTreeCmpKind cmpkind;
+  PosetCmpFn cmp_fn;
+};
+
+BPTree
+dflt5_BPTree (size_t key_sz, ptrdiff_t link_off, ptrdiff_t idx_off,
+              BPTreeCmpKind cmpkind, PosetCmpFn cmp_fn);
+void
+lose_BPTree (BPTree* t);
+void
+clear_BPTree (BPTree* t);
+Sign
+cmp_keys_BPTree (const BPTree* t, const void* a, const void* b);
+void*
+find_BPTree (const BPTree* t, const void* key);
+void
+insert_BPTree (BPTree* t, const void* key, void* p);
+void*
+ensure_BPTree (BPTree* t, const void* key, void* p);
+void
+remove_BPTree (BPTree* t, void* p);
+void*
+beg_BPTree (const BPTree* t);
+void*
+next_BPTNode (const BPTNode* x, zuint i);
+void*
+lower_bound_BPTree (const BPTree* t, const void* key);
+void*
+upper_bound_BPTree (const BPTree* t, const void* key);
+
+/** Get the leaf which holds payload {p}.**/
+qual_inline
+  BPTNode*
+leaf_of_BPTree (const BPTree* t, const void* p)
+{
+  return *CastOff( BPTNode*, p ,+, t->link_off );
+}
+
+/** Get the index of payload {p} in its leaf.**/
+qual_inline
+  zuint
+idx_of_BPTree (const BPTree* t, const void* p)
+{
+  zuint i;
+  memcpy (&i, CastOff( const void, p ,+, t->idx_off ), sizeof(i));
+  return i;
+}
+
+#endif
+
@@ -36,9 +36,10 @@ lose_BSTree (BSTree* t, void (* lose) (BSTNode*))
         BSTNode* x = y;
         Bit side = 0;
 
-        /* Descend to the lo side.*/
+        /* Descend to the lo side, fetching the hi sides early.*/
         do
         {
+            Prefetch( x->split[1] );
             y = x;
             x = x->split[0];
         } while (x);
@@ -71,9 +72,10 @@ walk_BSTree (BSTree* t, Trit postorder,
         BSTNode* x = y;
         Bit side = 0;
 
-        /* Descend to the lo side.*/
+        /* Descend to the lo side, fetching the hi sides early.*/
         do
         {
+            Prefetch( x->split[1] );
             if (postorder == Nil)  f (x, dat);
             y = x;
             x = x->split[0];
@@ -108,6 +110,50 @@ find_BSTree (BSTree* t, const void* key)
   return 0;
 }
 
+/** Find the first node whose key is not less than {key},
+ * or greater than {key} when {upper} is set.
+ **/
+static
+  BSTNode*
+bound_BSTree (BSTree* t, const void* key, Bit upper)
+{
+  BSTNode* y = root_of_BSTree (t);
+  BSTNode* b = 0;
+
+  while (y)
+  {
+    Sign si = poset_cmp_lhs (t->cmp, key, y);
+    if (si < 0 || (si == 0 && !upper))
+    {
+      b = y;
+      y = y->split[0];
+    }
+    else
+    {
+      y = y->split[1];
+    }
+  }
+  return b;
+}
+
+/** Get the first node whose key is not less than {key}.
+ * \return  NULL when no such node exists.
+ **/
+  BSTNode*
+lower_bound_BSTree (BSTree* t, const void* key)
+{
+  return bound_BSTree (t, key, 0);
+}
+
+/** Get the first node whose key is greater than {key}.
+ * \return  NULL when no such node exists.
+ **/
+  BSTNode*
+upper_bound_BSTree (BSTree* t, const void* key)
+{
+  return bound_BSTree (t, key, 1);
+}
+
   void
 insert_BSTree (BSTree* t, BSTNode* x)
 {
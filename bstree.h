@@ -7,6 +7,7 @@
 #define BSTree_H_
 
 #include "def.h"
+#include <string.h>
 #endif
 
 typedef struct BSTNode BSTNode;
@@ -39,6 +40,10 @@ walk_BSTree (BSTree* t, Trit postorder,
              void (* f) (BSTNode*, void*), void* dat);
 BSTNode*
 find_BSTree (BSTree* t, const void* key);
+BSTNode*
+lower_bound_BSTree (BSTree* t, const void* key);
+BSTNode*
+upper_bound_BSTree (BSTree* t, const void* key);
 void
 insert_BSTree (BSTree* t, BSTNode* x);
 BSTNode*
@@ -47,6 +52,79 @@ BSTNode*
 setf_BSTree (BSTree* t, BSTNode* x);
 void
 remove_BSTNode (BSTNode* y);
+
+/** Declare search functions for a tree whose keys have a known type.
+ *
+ * They act like find_BSTree(), insert_BSTree() and ensure_BSTree(),
+ * but the key comparison is inlined rather than called through
+ * {t->cmp.fn}. Only {t->cmp.off} is used to locate keys.
+ *
+ * \param Name  Suffix for the function names, like find_Name_BSTree().
+ * \param KeyT  Type of key.
+ * \param CmpExpr  Expression comparing keys {*a} and {*b},
+ *   which are of type {const KeyT*}. It should give a \ref Sign.
+ **/
+#define DeclBSTreeT( Name, KeyT, CmpExpr ) \
+qual_inline \
+  Sign \
+cmp_##Name##_BSTree (const KeyT* a, const KeyT* b) \
+{ \
+  return (CmpExpr); \
+} \
+qual_inline \
+  const KeyT* \
+key_of_##Name##_BSTree (const BSTree* t, const BSTNode* x) \
+{ \
+  return CastOff( const KeyT, x ,+, t->cmp.off ); \
+} \
+qual_inline \
+  BSTNode* \
+find_##Name##_BSTree (BSTree* t, const KeyT* key) \
+{ \
+  BSTNode* y = root_of_BSTree (t); \
+  while (y) \
+  { \
+    const Sign si = cmp_##Name##_BSTree (key, key_of_##Name##_BSTree (t, y)); \
+    if (si == 0)  return y; \
+    y = y->split[si > 0 ? 1 : 0]; \
+  } \
+  return 0; \
+} \
+qual_inline \
+  BSTNode* \
+ensure1_##Name##_BSTree (BSTree* t, BSTNode* x, bool dups) \
+{ \
+  const KeyT* key = key_of_##Name##_BSTree (t, x); \
+  BSTNode* a = t->sentinel; \
+  BSTNode* y = root_of_BSTree (t); \
+  Bit side = 0; \
+  while (y) \
+  { \
+    const Sign si = cmp_##Name##_BSTree (key, key_of_##Name##_BSTree (t, y)); \
+    if (si == 0 && !dups)  return y; \
+    side = (si > 0 ? 1 : 0); \
+    a = y; \
+    y = y->split[side]; \
+  } \
+  a->split[side] = x; \
+  x->joint = a; \
+  x->split[0] = 0; \
+  x->split[1] = 0; \
+  return x; \
+} \
+qual_inline \
+  void \
+insert_##Name##_BSTree (BSTree* t, BSTNode* x) \
+{ \
+  (void) ensure1_##Name##_BSTree (t, x, true); \
+} \
+qual_inline \
+  BSTNode* \
+ensure_##Name##_BSTree (BSTree* t, BSTNode* x) \
+{ \
+  return ensure1_##Name##_BSTree (t, x, false); \
+}
+
 #endif  /* #ifndef __OPENCL_VERSION__ */
 
 void
@@ -152,5 +230,16 @@ next_BSTNode (BSTNode* x)
     return 0;
 }
 
+#ifndef __OPENCL_VERSION__
+#define CmpExpr_BSTree( a, b )  ((a) < (b) ? -1 : (a) > (b) ? 1 : 0)
+
+DeclBSTreeT( int, int, CmpExpr_BSTree( *a, *b ) )
+DeclBSTreeT( uint, uint, CmpExpr_BSTree( *a, *b ) )
+DeclBSTreeT( zuint, zuint, CmpExpr_BSTree( *a, *b ) )
+DeclBSTreeT( MemLoc, void*,
+             CmpExpr_BSTree( (uintptr_t) *a, (uintptr_t) *b ) )
+DeclBSTreeT( cstr, char*, sign_of( strcmp (*a, *b) ) )
+#endif  /* #ifndef __OPENCL_VERSION__ */
+
 #endif
 
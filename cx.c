@@ -154,7 +154,7 @@ init_CxExecOpt (CxExecOpt* opt)
 {
   opt->cplusplus = false;
   opt->del_quote_include = false;
-  InitSet( const char*, opt->del_pragmas, (PosetCmpFn) cmp_cstr_loc );
+  InitHashSet( const char*, opt->del_pragmas, hash_cstr_loc, cmp_cstr_loc );
 }
 
   void
@@ -365,7 +365,7 @@ cstr_SyntaxKind (SyntaxKind kind)
     void
 init_lexwords (Associa* map)
 {
-    InitAssocia( AlphaTab, SyntaxKind, *map, cmp_AlphaTab );
+    InitHashAssocia( AlphaTab, SyntaxKind, *map, hash_AlphaTab, cmp_AlphaTab );
 
     {SyntaxKind kind = Beg_Syntax_LexWords;for (;
          kind < End_Syntax_LexWords;
@@ -663,6 +663,92 @@ xgetn_byte_XFileB (XFileB* xfb, byte* a, zuint n)
   return true;
 }
 
+static
+  fd_t
+fd_of_FileB (const FileB* fb)
+{
+  if (fb->fd >= 0)  return fb->fd;
+  if (!fb->f)  return -1;
+#ifdef POSIX_SOURCE
+  return fileno (fb->f);
+#else
+  return _fileno (fb->f);
+#endif
+}
+
+/** Move up to {sz} bytes from {xfb} to {ofb}, stopping early at end of input.
+ *
+ * Bytes buffered in either XFileB or OFileB go first.
+ * The rest move between the file descriptors through splice_sysCx(),
+ * so they need not be copied through this process.
+ * Use the XFileB and OFileB of an OSPc to join its pipes to a file
+ * or to another OSPc.
+ *
+ * Input which stdio buffered in the FILE of {xfb} is not seen,
+ * so do not mix this with reads that leave bytes in that buffer.
+ * On error, {xfb->fb.good} is set to false.
+ * \return  Number of bytes moved.
+ **/
+  zuint
+splice_FileB (OFileB* ofb, XFileB* xfb, zuint sz)
+{
+  XFile* const xf = &xfb->xf;
+  const fd_t xfd = fd_of_FileB (&xfb->fb);
+  const fd_t ofd = fd_of_FileB (&ofb->fb);
+  zuint nbuf = xf->buf.sz - xf->off;
+  zuint off = 0;
+
+  if (xfd < 0 || ofd < 0)
+  {
+    xfb->fb.good = false;
+    return 0;
+  }
+
+  if (nullt_FileB (&xfb->fb) && nbuf > 0)
+    nbuf -= 1;
+  if (nbuf > sz)
+    nbuf = sz;
+
+  /* The bytes which were read but not taken yet go along with
+   * whatever the OFileB holds.
+   */
+  if (!flush1_OFileB (ofb, &xf->buf.s[xf->off], nbuf))
+  {
+    xfb->fb.good = false;
+    return 0;
+  }
+  if (nbuf > 0)
+  {
+    xf->off += nbuf;
+    flush_XFileB (xfb);
+  }
+  off = nbuf;
+
+  while (off < sz)
+  {
+    const zuint n = (sz - off < (zuint) LONG_MAX ? sz - off : (zuint) LONG_MAX);
+    long ret = splice_sysCx (xfd, ofd, (long) n);
+    if (ret > 0)
+    {
+      off += ret;
+    }
+    else if (ret == 0)
+    {
+      break;
+    }
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      break;
+    }
+    else if (errno != EINTR)
+    {
+      xfb->fb.good = false;
+      break;
+    }
+  }
+  return off;
+}
+
   AlphaTab
 textfile_AlphaTab (const char* pathname, const char* filename)
 {
@@ -107,6 +107,8 @@ oputn_byte_OFileB (OFileB* f, const byte* a, zuint n);
 
 bool
 xgetn_byte_XFileB (XFileB* xfb, byte* a, zuint n);
+zuint
+splice_FileB (OFileB* ofb, XFileB* xfb, zuint sz);
 
 AlphaTab
 textfile_AlphaTab (const char* pathname, const char* filename);
@@ -0,0 +1,350 @@
+/**
+ * \file hashtable.c
+ * Unordered hash table of payload pointers.
+ **/
+#include "hashtable.h"
+#include "thirdparty/hash-ThomasWang.c"
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GroupSz  16
+#define Empty    0x80
+#define Deleted  0xFE
+
+static
+  uint
+lsbidx (uint x)
+{
+#ifdef __GNUC__
+  return __builtin_ctz (x);
+#else
+  uint n = 0;
+  for (; (x & 1) == 0; x >>= 1)
+    ++n;
+  return n;
+#endif
+}
+
+/** Mask of the slots in a group whose control byte is {b}.**/
+static
+  uint
+match_ctrl (const byte* g, byte b)
+{
+#ifdef __SSE2__
+  const __m128i x = _mm_loadu_si128 ((const __m128i*) g);
+  return (uint) _mm_movemask_epi8 (_mm_cmpeq_epi8 (x, _mm_set1_epi8 ((char) b)));
+#else
+  uint m = 0;
+  {uint i = 0;for (; i < GroupSz; ++i)
+    if (g[i] == b)  m |= (1u << i);}
+  return m;
+#endif
+}
+
+/** Mask of the slots in a group which are empty or deleted.**/
+static
+  uint
+match_avail (const byte* g)
+{
+#ifdef __SSE2__
+  const __m128i x = _mm_loadu_si128 ((const __m128i*) g);
+  return (uint) _mm_movemask_epi8 (x);
+#else
+  uint m = 0;
+  {uint i = 0;for (; i < GroupSz; ++i)
+    if (g[i] & 0x80)  m |= (1u << i);}
+  return m;
+#endif
+}
+
+static
+  const void*
+key_of (const HashTable* t, const void* p)
+{
+  return CastOff( const void, p ,+, t->key_off );
+}
+
+/** Index of the group where probing starts.**/
+static
+  zuint
+group_of (const HashTable* t, uint32_t h)
+{
+  return (h >> 7) & (t->cap / GroupSz - 1);
+}
+
+static
+  byte
+h2_of (uint32_t h)
+{
+  return (byte) (h & 0x7F);
+}
+
+/** Find the slot holding a payload matching {key}.
+ * \param p  If nonzero, only match this payload.
+ * \return  SIZE_MAX when nothing matches.
+ **/
+static
+  zuint
+find_slot (const HashTable* t, const void* key, const void* p)
+{
+  uint32_t h;
+  zuint g;
+  zuint k = 0;
+  if (t->cap == 0)  return SIZE_MAX;
+  h = t->hash (key);
+  g = group_of (t, h);
+
+  while (1) {
+    const byte* ctrl = &t->ctrl[g * GroupSz];
+    uint m = match_ctrl (ctrl, h2_of (h));
+    while (m != 0) {
+      const zuint i = g * GroupSz + lsbidx (m);
+      const void* q = t->slots[i];
+      m &= m - 1;
+      if (p ? (q == p) : (0 == t->cmp_fn (key_of (t, q), key)))
+        return i;
+    }
+    if (match_ctrl (ctrl, Empty) != 0)
+      return SIZE_MAX;
+    ++k;
+    g = (g + k) & (t->cap / GroupSz - 1);
+  }
+}
+
+/** Slot of {p}, which must be in the table.**/
+static
+  zuint
+slot_of (const HashTable* t, const void* p)
+{
+  zuint i;
+  if (t->idx_off >= 0)
+    memcpy (&i, CastOff( const void, p ,+, t->idx_off ), sizeof(i));
+  else
+    i = find_slot (t, key_of (t, p), p);
+  Claim2( i ,<, t->cap );
+  Claim( t->slots[i] == p );
+  Claim( !(t->ctrl[i] & 0x80) );
+  return i;
+}
+
+/** Find the first empty or deleted slot on the probe path of {h}.**/
+static
+  zuint
+avail_slot (const HashTable* t, uint32_t h)
+{
+  const zuint mask = t->cap / GroupSz - 1;
+  zuint g = group_of (t, h);
+  zuint k = 0;
+  while (1) {
+    const uint m = match_avail (&t->ctrl[g * GroupSz]);
+    if (m != 0)
+      return g * GroupSz + lsbidx (m);
+    ++k;
+    g = (g + k) & mask;
+  }
+}
+
+static
+  void
+place (HashTable* t, zuint i, uint32_t h, void* p)
+{
+  if (t->ctrl[i] == Deleted)
+    -- t->ntombs;
+  t->ctrl[i] = h2_of (h);
+  t->slots[i] = p;
+  if (t->idx_off >= 0)
+    memcpy (CastOff( void, p ,+, t->idx_off ), &i, sizeof(i));
+  ++ t->sz;
+}
+
+/** Resize and drop deleted slots.**/
+static
+  void
+rehash (HashTable* t, zuint sz)
+{
+  byte* ctrl = t->ctrl;
+  void** slots = t->slots;
+  const zuint cap = t->cap;
+  zuint new_cap = GroupSz;
+
+  /* Keep the load at or below 7/16 so several inserts fit before
+   * the next rehash.
+   */
+  while (sz * 16 > new_cap * 7)
+    new_cap *= 2;
+
+  t->cap = new_cap;
+  t->ctrl = AllocT( byte, new_cap );
+  t->slots = AllocT( void*, new_cap );
+  memset (t->ctrl, Empty, new_cap);
+  t->sz = 0;
+  t->ntombs = 0;
+
+  {zuint i = 0;for (; i < cap; ++i) {
+    if (!(ctrl[i] & 0x80)) {
+      const uint32_t h = t->hash (key_of (t, slots[i]));
+      place (t, avail_slot (t, h), h, slots[i]);
+    }
+  }}
+  if (ctrl)  free (ctrl);
+  if (slots)  free (slots);
+}
+
+/** Make sure one more payload fits while keeping the load under 7/8.**/
+static
+  void
+reserve1 (HashTable* t)
+{
+  if ((t->sz + t->ntombs + 1) * 8 > t->cap * 7)
+    rehash (t, t->sz + 1);
+}
+
+  HashTable
+dflt3_HashTable (ptrdiff_t key_off, HashFn hash, PosetCmpFn cmp_fn)
+{
+  HashTable t;
+  t.ctrl = 0;
+  t.slots = 0;
+  t.cap = 0;
+  t.sz = 0;
+  t.ntombs = 0;
+  t.key_off = key_off;
+  t.idx_off = -1;
+  t.hash = hash;
+  t.cmp_fn = cmp_fn;
+  return t;
+}
+
+  void
+lose_HashTable (HashTable* t)
+{
+  if (t->ctrl)  free (t->ctrl);
+  if (t->slots)  free (t->slots);
+}
+
+/** Remove everything without looking at any payloads.**/
+  void
+clear_HashTable (HashTable* t)
+{
+  const ptrdiff_t idx_off = t->idx_off;
+  lose_HashTable (t);
+  *t = dflt3_HashTable (t->key_off, t->hash, t->cmp_fn);
+  t->idx_off = idx_off;
+}
+
+/** Find a payload whose key matches {key}.
+ * \return  NULL when no such payload exists.
+ **/
+  void*
+find_HashTable (const HashTable* t, const void* key)
+{
+  const zuint i = find_slot (t, key, 0);
+  if (i == SIZE_MAX)  return 0;
+  return t->slots[i];
+}
+
+/** Insert payload {p}.
+ * This can form duplicates.
+ **/
+  void
+insert_HashTable (HashTable* t, void* p)
+{
+  uint32_t h;
+  reserve1 (t);
+  h = t->hash (key_of (t, p));
+  place (t, avail_slot (t, h), h, p);
+}
+
+/** If a payload matching the key of {p} exists, return it.
+ * Otherwise, insert {p} and return it.
+ **/
+  void*
+ensure_HashTable (HashTable* t, void* p)
+{
+  void* q = find_HashTable (t, key_of (t, p));
+  if (q)  return q;
+  insert_HashTable (t, p);
+  return p;
+}
+
+/** Remove payload {p} from the table.**/
+  void
+remove_HashTable (HashTable* t, void* p)
+{
+  const zuint i = slot_of (t, p);
+  t->ctrl[i] = Deleted;
+  -- t->sz;
+  ++ t->ntombs;
+}
+
+static
+  void*
+nextge (const HashTable* t, zuint i)
+{
+  for (; i < t->cap; ++i)
+    if (!(t->ctrl[i] & 0x80))
+      return t->slots[i];
+  return 0;
+}
+
+/** Get the first payload, in no particular order.**/
+  void*
+beg_HashTable (const HashTable* t)
+{
+  return nextge (t, 0);
+}
+
+/** Get the payload after {p}, in no particular order.**/
+  void*
+next_HashTable (const HashTable* t, const void* p)
+{
+  return nextge (t, 1 + slot_of (t, p));
+}
+
+/** Hash some bytes by feeding words through Thomas Wang's hash.**/
+  uint32_t
+hash_bytes (const void* p, zuint n)
+{
+  const byte* s = (const byte*) p;
+  uint32_t h = uint32_hash_ThomasWang ((uint32_t) n);
+  for (; n >= 4; n -= 4, s += 4) {
+    uint32_t w;
+    memcpy (&w, s, 4);
+    h = uint32_hash_ThomasWang (h ^ w) + w;
+  }
+  if (n > 0) {
+    uint32_t w = 0;
+    memcpy (&w, s, n);
+    h = uint32_hash_ThomasWang (h ^ w) + w;
+  }
+  return uint32_hash_ThomasWang (h);
+}
+
+  uint32_t
+hash_uint (const uint* x)
+{
+  return uint32_hash_ThomasWang (*x);
+}
+
+/** Hash a pointer by its address.**/
+  uint32_t
+hash_MemLoc (const void* const* x)
+{
+  return (uint32_t) uint64_hash_ThomasWang ((uint64_t) (uintptr_t) *x);
+}
+
+/** Compare two pointers by the addresses they hold.
+ * This pairs with hash_MemLoc(), but it is a total order,
+ * so ordered maps can use it too.
+ **/
+  Sign
+cmp_MemLoc (const void* const* a, const void* const* b)
+{
+  if ((size_t) *a < (size_t) *b)  return -1;
+  if ((size_t) *a > (size_t) *b)  return 1;
+  return 0;
+}
+
@@ -0,0 +1,67 @@
+/**
+ * \file hashtable.h
+ * Unordered hash table of payload pointers.
+ *
+ * This is an open-addressing table in the style of Swiss tables.
+ * Slots are grouped 16 at a time, and each slot has a control byte
+ * holding 7 bits of its hash, so a probe checks a whole group at once
+ * (with SSE2 when available) before comparing any keys.
+ *
+ * The table only stores pointers to payloads owned by the caller.
+ * Each payload holds its key at {key_off} bytes into it.
+ * If {idx_off} is set, each payload also gets a zuint at that offset
+ * which the table keeps equal to its slot, so iterating and removing
+ * need not hash the key.
+ **/
+#ifndef HashTable_H_
+#define HashTable_H_
+#include "def.h"
+
+typedef struct HashTable HashTable;
+
+/** Type of function which hashes a key.**/
+typedef uint32_t (* HashFn) (const void*);
+
+struct HashTable
+{
+  byte* ctrl;  /**< Control byte for each slot.**/
+  void** slots;  /**< Payload for each slot.**/
+  zuint cap;  /**< Number of slots. Zero or a power of 2 at least 16.**/
+  zuint sz;  /**< Number of payloads.**/
+  zuint ntombs;  /**< Number of slots marked as deleted.**/
+  ptrdiff_t key_off;
+  ptrdiff_t idx_off;  /**< Where payloads keep their slot, or -1.**/
+  HashFn hash;
+  PosetCmpFn cmp_fn;  /**< Only used to check for equality.**/
+};
+
+HashTable
+dflt3_HashTable (ptrdiff_t key_off, HashFn hash, PosetCmpFn cmp_fn);
+void
+lose_HashTable (HashTable* t);
+void
+clear_HashTable (HashTable* t);
+void*
+find_HashTable (const HashTable* t, const void* key);
+void
+insert_HashTable (HashTable* t, void* p);
+void*
+ensure_HashTable (HashTable* t, void* p);
+void
+remove_HashTable (HashTable* t, void* p);
+void*
+beg_HashTable (const HashTable* t);
+void*
+next_HashTable (const HashTable* t, const void* p);
+
+uint32_t
+hash_bytes (const void* p, zuint n);
+uint32_t
+hash_uint (const uint* x);
+uint32_t
+hash_MemLoc (const void* const* x);
+Sign
+cmp_MemLoc (const void* const* a, const void* const* b);
+
+#endif
+
@@ -0,0 +1,461 @@
+/**
+ * \file ospcloop.c
+ * Drive many processes at once from one thread.
+ **/
+#ifdef __linux__
+/* For syscall().*/
+#define _DEFAULT_SOURCE
+#endif
+#include "ospcloop.h"
+
+#include <errno.h>
+#include <signal.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#endif
+
+/** Kinds of events, which are the low bits of an event's key.**/
+enum OSPcLoopTag { OSPcLoop_Out, OSPcLoop_In, OSPcLoop_Pid };
+#define NBits_OSPcLoopTag 2
+
+/** How long to wait between checks on processes without a pidfd.**/
+#define PollMs_OSPcLoop 10
+
+#ifdef __linux__
+
+static
+  fd_t
+pidfd_of (pid_t pid)
+{
+#ifdef SYS_pidfd_open
+  return (fd_t) syscall (SYS_pidfd_open, pid, 0);
+#else
+  (void) pid;
+  return -1;
+#endif
+}
+
+static
+  bool
+watch_fd (OSPcLoop* loop, fd_t fd, uint32_t events,
+          OSPcWatch* w, enum OSPcLoopTag tag)
+{
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.u64 = ((uint64_t) w->idx << NBits_OSPcLoopTag) | tag;
+  return 0 == epoll_ctl (loop->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static
+  void
+unwatch_fd (OSPcLoop* loop, fd_t fd)
+{
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof(ev));
+  epoll_ctl (loop->epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+static
+  bool
+nonblock_fd (fd_t fd)
+{
+  const int flags = fcntl (fd, F_GETFL);
+  if (flags == -1)  return false;
+  return 0 == fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+#endif
+
+/** Make an empty loop.
+ * \sa lose_OSPcLoop()
+ **/
+  bool
+init_OSPcLoop (OSPcLoop* loop)
+{
+  *loop = dflt_OSPcLoop ();
+#ifdef __linux__
+  signal (SIGPIPE, SIG_IGN);
+  loop->epfd = epoll_create1 (EPOLL_CLOEXEC);
+#endif
+  return (loop->epfd >= 0);
+}
+
+/** Forget about a watch which is done or being dropped.**/
+static
+  void
+drop_watch (OSPcLoop* loop, OSPcWatch* w)
+{
+  loop->watches.s[w->idx] = 0;
+  PushTable( loop->dead_idcs, w->idx );
+  loop->nlive -= 1;
+  if (w->pidfd >= 0)
+  {
+    closefd_sysCx (w->pidfd);
+    w->pidfd = -1;
+  }
+  else if (!w->exited)
+  {
+    loop->npolled -= 1;
+  }
+#ifdef __linux__
+  if (!w->in_gone)
+    unwatch_fd (loop, w->ospc->ofb.fb.fd);
+  if (w->ospc->xf && !w->eof)
+    unwatch_fd (loop, w->ospc->xfb.fb.fd);
+#endif
+  LoseTable( w->obuf );
+  LoseTable( w->line );
+  w->ooff = 0;
+}
+
+/** Free the loop.
+ * Processes which are still running are not waited for.
+ * Their OSPc can still be closed as usual.
+ **/
+  void
+lose_OSPcLoop (OSPcLoop* loop)
+{
+  {zuint i = 0;for (; i < loop->watches.sz; ++i) {
+    if (loop->watches.s[i])
+      drop_watch (loop, (OSPcWatch*) loop->watches.s[i]);
+  }}
+  LoseTable( loop->watches );
+  LoseTable( loop->free_idcs );
+  LoseTable( loop->dead_idcs );
+  if (loop->epfd >= 0)
+    closefd_sysCx (loop->epfd);
+  loop->epfd = -1;
+}
+
+/** Close the process's stdin, dropping whatever was not written.**/
+static
+  void
+close_in (OSPcLoop* loop, OSPcWatch* w)
+{
+  OFileB* ofb = &w->ospc->ofb;
+#ifdef __linux__
+  unwatch_fd (loop, ofb->fb.fd);
+#else
+  (void) loop;
+#endif
+  close_OFileB (ofb);
+  ClearTable( w->obuf );
+  w->ooff = 0;
+  w->in_gone = true;
+}
+
+static
+  void
+finish_watch (OSPcLoop* loop, OSPcWatch* w)
+{
+  OSPc* ospc = w->ospc;
+  if (!w->eof || !w->exited)  return;
+  /* The process was reaped, so close_OSPc() would skip these.*/
+  if (!w->in_gone)
+    close_in (loop, w);
+  drop_watch (loop, w);
+  if (ospc->xf)
+    close_XFileB (&ospc->xfb);
+  if (w->exit_fn)
+    w->exit_fn (w);
+}
+
+/** Write what is waiting for the process's stdin, as much as fits.**/
+static
+  void
+flush_in (OSPcLoop* loop, OSPcWatch* w)
+{
+  OFileB* ofb = &w->ospc->ofb;
+  if (w->in_gone)  return;
+
+  while (w->ooff < w->obuf.sz)
+  {
+    long n = write_sysCx (ofb->fb.fd, &w->obuf.s[w->ooff],
+                          (long) (w->obuf.sz - w->ooff));
+    if (n > 0)
+    {
+      w->ooff += n;
+    }
+    else if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      return;
+    }
+    else
+    {
+      /* The process closed its stdin.*/
+      close_in (loop, w);
+      return;
+    }
+  }
+  ClearTable( w->obuf );
+  w->ooff = 0;
+
+  if (w->close_in)
+    close_in (loop, w);
+}
+
+/** Pass a chunk of output on, splitting it into lines if needed.**/
+static
+  void
+take_output (OSPcWatch* w, byte* buf, zuint sz)
+{
+  zuint beg = 0;
+  if (w->chunk_fn)
+    w->chunk_fn (w, buf, sz);
+  if (!w->line_fn)  return;
+
+  {zuint i = 0;for (; i < sz; ++i)
+  {
+    char* s;
+    zuint n;
+    if (buf[i] != '\n')  continue;
+
+    n = i - beg;
+    if (w->line.sz > 0)
+    {
+      GrowTable( w->line, n+1 );
+      memcpy (&w->line.s[w->line.sz-(n+1)], &buf[beg], n);
+      w->line.s[w->line.sz-1] = 0;
+      s = (char*) w->line.s;
+      n = w->line.sz-1;
+    }
+    else
+    {
+      buf[i] = 0;
+      s = (char*) &buf[beg];
+    }
+    if (n > 0 && s[n-1] == '\r')
+      s[n-1] = 0;
+    w->line_fn (w, s);
+    ClearTable( w->line );
+    beg = i+1;
+  }}
+
+  if (beg < sz)
+  {
+    const zuint n = sz - beg;
+    GrowTable( w->line, n );
+    memcpy (&w->line.s[w->line.sz-n], &buf[beg], n);
+  }
+}
+
+/** Read what the process wrote, as much as is ready.**/
+static
+  void
+drain_out (OSPcLoop* loop, OSPcWatch* w)
+{
+  const fd_t fd = w->ospc->xfb.fb.fd;
+  byte buf[BUFSIZ];
+
+  while (!w->eof)
+  {
+    long n = read_sysCx (fd, buf, sizeof(buf));
+    if (n > 0)
+    {
+      take_output (w, buf, n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+
+    w->eof = true;
+#ifdef __linux__
+    unwatch_fd (loop, fd);
+#endif
+    if (w->line_fn && w->line.sz > 0)
+    {
+      PushTable( w->line, 0 );
+      w->line_fn (w, (char*) w->line.s);
+      ClearTable( w->line );
+    }
+  }
+  finish_watch (loop, w);
+}
+
+/** Note the exit of the process, which is known to have happened.**/
+static
+  void
+reap (OSPcLoop* loop, OSPcWatch* w, int status)
+{
+  OSPc* ospc = w->ospc;
+  if (w->pidfd >= 0)
+  {
+#ifdef __linux__
+    unwatch_fd (loop, w->pidfd);
+#endif
+    closefd_sysCx (w->pidfd);
+    w->pidfd = -1;
+  }
+  else
+  {
+    loop->npolled -= 1;
+  }
+  ospc->status = status;
+  ospc->pid = -1;
+  w->exited = true;
+  finish_watch (loop, w);
+}
+
+/** Add a process, which was spawned by spawn_OSPc().
+ * If its output is piped (see stdopipe_OSPc()), it is read as it comes.
+ * If its input is piped (see stdxpipe_OSPc()),
+ * use write_OSPcLoop() and close_in_OSPcLoop() to feed it.
+ **/
+  bool
+add_OSPcLoop (OSPcLoop* loop, OSPcWatch* w)
+{
+#ifdef __linux__
+  OSPc* ospc = w->ospc;
+  bool good = true;
+  Claim2( ospc->pid ,>=, 0 );
+
+  if (loop->free_idcs.sz > 0)
+  {
+    w->idx = *TopTable( loop->free_idcs );
+    CPopTable( loop->free_idcs, 1 );
+    loop->watches.s[w->idx] = w;
+  }
+  else
+  {
+    w->idx = loop->watches.sz;
+    PushTable( loop->watches, w );
+  }
+  w->pidfd = -1;
+  w->ooff = 0;
+  InitTable( w->obuf );
+  InitTable( w->line );
+  w->close_in = false;
+  w->in_gone = !ospc->of;
+  w->eof = !ospc->xf;
+  w->exited = false;
+  loop->nlive += 1;
+
+  w->pidfd = pidfd_of (ospc->pid);
+  if (w->pidfd >= 0)
+    good = watch_fd (loop, w->pidfd, EPOLLIN, w, OSPcLoop_Pid);
+  else
+    loop->npolled += 1;
+
+  if (good && ospc->xf)
+    good = nonblock_fd (ospc->xfb.fb.fd) &&
+      watch_fd (loop, ospc->xfb.fb.fd, EPOLLIN, w, OSPcLoop_Out);
+
+  /* Edge-triggered, so it only wakes us when more fits.*/
+  if (good && ospc->of)
+    good = nonblock_fd (ospc->ofb.fb.fd) &&
+      watch_fd (loop, ospc->ofb.fb.fd, EPOLLOUT | EPOLLET, w, OSPcLoop_In);
+
+  if (!good)
+  {
+    DBog0( "Cannot watch process." );
+    drop_watch (loop, w);
+  }
+  return good;
+#else
+  (void) loop;
+  (void) w;
+  return false;
+#endif
+}
+
+/** Write to the process's stdin without blocking.
+ * What does not fit is written as the process reads.
+ * Nothing is written once the process closed its stdin.
+ **/
+  void
+write_OSPcLoop (OSPcLoop* loop, OSPcWatch* w, const void* buf, zuint sz)
+{
+  Claim( !w->close_in );
+  if (w->in_gone)  return;
+  GrowTable( w->obuf, sz );
+  memcpy (&w->obuf.s[w->obuf.sz - sz], buf, sz);
+  flush_in (loop, w);
+}
+
+/** Close the process's stdin once everything written to it went through.**/
+  void
+close_in_OSPcLoop (OSPcLoop* loop, OSPcWatch* w)
+{
+  if (w->in_gone)  return;
+  w->close_in = true;
+  flush_in (loop, w);
+}
+
+/** Wait for events and handle them.
+ * \param timeout_ms  Longest time to wait, or -1 to wait for an event.
+ * \return  Whether any processes are left.
+ **/
+  bool
+wait_OSPcLoop (OSPcLoop* loop, int timeout_ms)
+{
+#ifdef __linux__
+  struct epoll_event evs[64];
+  int nevs;
+
+  /* No event from before can name these anymore.*/
+  {zuint i = 0;for (; i < loop->dead_idcs.sz; ++i)
+    PushTable( loop->free_idcs, loop->dead_idcs.s[i] );}
+  ClearTable( loop->dead_idcs );
+
+  if (loop->nlive == 0)  return false;
+  if (loop->npolled > 0 &&
+      (timeout_ms < 0 || timeout_ms > PollMs_OSPcLoop))
+    timeout_ms = PollMs_OSPcLoop;
+
+  nevs = epoll_wait (loop->epfd, evs, ArraySz( evs ), timeout_ms);
+  {int i = 0;for (; i < nevs; ++i)
+  {
+    const zuint idx = (zuint) (evs[i].data.u64 >> NBits_OSPcLoopTag);
+    const uint tag = (uint) (evs[i].data.u64 & ((1 << NBits_OSPcLoopTag) - 1));
+    OSPcWatch* w = (OSPcWatch*) loop->watches.s[idx];
+    if (!w)  continue;
+
+    if (tag == OSPcLoop_Out)
+    {
+      drain_out (loop, w);
+    }
+    else if (tag == OSPcLoop_In)
+    {
+      flush_in (loop, w);
+    }
+    else
+    {
+      int status = 0;
+      if (!waitpid_sysCx (w->ospc->pid, &status))
+        status = -1;
+      reap (loop, w, status);
+    }
+  }}
+
+  /* Processes without a pidfd are checked each time around.*/
+  {zuint i = 0;for (; loop->npolled > 0 && i < loop->watches.sz; ++i)
+  {
+    OSPcWatch* w = (OSPcWatch*) loop->watches.s[i];
+    int status = 0;
+    if (!w || w->pidfd >= 0 || w->exited)  continue;
+    if (waitpid (w->ospc->pid, &status, WNOHANG) == w->ospc->pid)
+      reap (loop, w, WEXITSTATUS( status ));
+  }}
+  return (loop->nlive > 0);
+#else
+  (void) timeout_ms;
+  return (loop->nlive > 0);
+#endif
+}
+
+/** Handle events until every process is done.**/
+  void
+run_OSPcLoop (OSPcLoop* loop)
+{
+  while (wait_OSPcLoop (loop, -1))
+  {}
+}
+
@@ -0,0 +1,111 @@
+/**
+ * \file ospcloop.h
+ * Drive many processes at once from one thread.
+ *
+ * Each process is an \ref OSPc which was spawned with pipes.
+ * The loop waits on all of their pipes with epoll, reads and writes them
+ * without blocking, and reaps each process through a pidfd once it exits.
+ * While a process is in the loop, only use its pipes through the loop,
+ * since the descriptors are made non-blocking.
+ *
+ * Writing to a process which closed its stdin must not kill this one,
+ * so SIGPIPE is ignored once a loop is made.
+ * Processes spawned by spawnvp_sysCx() still get the default SIGPIPE.
+ *
+ * Once a process is done, the loop closes its pipes and reaps it,
+ * so close_OSPc() has nothing left to do.
+ **/
+#ifndef OSPcLoop_H_
+#define OSPcLoop_H_
+#include "ospc.h"
+
+typedef struct OSPcWatch OSPcWatch;
+typedef struct OSPcLoop OSPcLoop;
+
+/** A process in an OSPcLoop, along with what to do as it runs.
+ * It must stay at the same address while in the loop.
+ **/
+struct OSPcWatch
+{
+  OSPc* ospc;
+  /** Called with each chunk read from the process. Can be NULL.**/
+  void (* chunk_fn) (OSPcWatch*, const byte*, zuint);
+  /** Called with each line read from the process, without its newline.
+   * A last line without a newline is passed at the end of output.
+   * Can be NULL.
+   **/
+  void (* line_fn) (OSPcWatch*, char*);
+  /** Called once the process exited and all of its output was read.
+   * Its exit status is in {ospc->status}. Can be NULL.
+   **/
+  void (* exit_fn) (OSPcWatch*);
+  void* dat;
+
+  /* The rest is managed by the loop.*/
+  zuint idx;  /**< Index in the loop.**/
+  fd_t pidfd;  /**< Readable once the process exits, or -1.**/
+  TableT(byte) obuf;  /**< Bytes waiting to be written.**/
+  zuint ooff;  /**< Bytes of {obuf} written so far.**/
+  TableT(byte) line;  /**< Start of a line which is not complete.**/
+  bool close_in;  /**< Caller asked to close its stdin.**/
+  bool in_gone;  /**< Its stdin is closed, or was never piped.**/
+  bool eof;  /**< Its output is over.**/
+  bool exited;  /**< It was reaped.**/
+};
+#define DEFAULT_OSPcWatch \
+{ 0, 0, 0, 0, 0, \
+  0, -1, DEFAULT_Table, 0, DEFAULT_Table, \
+  false, true, false, false }
+
+struct OSPcLoop
+{
+  int epfd;
+  /** Watch at each index, or NULL once it is done.**/
+  TableT(MemLoc) watches;
+  /** Indices of {watches} which new watches can take.**/
+  TableT(zuint) free_idcs;
+  /** Indices freed while handling events. Events which were already
+   * fetched may still name them, so they are only reused after that.
+   **/
+  TableT(zuint) dead_idcs;
+  /** Number of watches which are not done.**/
+  zuint nlive;
+  /** Number of live watches without a pidfd, which must be polled.**/
+  zuint npolled;
+};
+#define DEFAULT_OSPcLoop \
+{ -1, DEFAULT_Table, DEFAULT_Table, DEFAULT_Table, 0, 0 }
+
+qual_inline
+  OSPcWatch
+dflt_OSPcWatch ()
+{
+  OSPcWatch w = DEFAULT_OSPcWatch;
+  return w;
+}
+
+qual_inline
+  OSPcLoop
+dflt_OSPcLoop ()
+{
+  OSPcLoop loop = DEFAULT_OSPcLoop;
+  return loop;
+}
+
+bool
+init_OSPcLoop (OSPcLoop* loop);
+void
+lose_OSPcLoop (OSPcLoop* loop);
+bool
+add_OSPcLoop (OSPcLoop* loop, OSPcWatch* w);
+void
+write_OSPcLoop (OSPcLoop* loop, OSPcWatch* w, const void* buf, zuint sz);
+void
+close_in_OSPcLoop (OSPcLoop* loop, OSPcWatch* w);
+bool
+wait_OSPcLoop (OSPcLoop* loop, int timeout_ms);
+void
+run_OSPcLoop (OSPcLoop* loop);
+
+#endif
+
@@ -24,10 +24,39 @@ split (RBTNode* x, Bit side)
     return y ? CastUp( RBTNode, bst, y ) : 0;
 }
 
+static zuint
+count_of (const RBTree* t, RBTNode* x)
+{
+    return x ? *CastOff( zuint, x ,+, t->count_off ) : 0;
+}
+
+/** Recompute the subtree size of {x} from its children.**/
+static void
+recount (const RBTree* t, RBTNode* x)
+{
+    *CastOff( zuint, x ,+, t->count_off ) =
+        1 + count_of (t, split (x, 0)) + count_of (t, split (x, 1));
+}
+
+/** Recompute subtree sizes from {x} up to the root.**/
 static void
-rotate (RBTNode* x, Bit lowup)
+recount_up (const RBTree* t, BSTNode* x)
 {
+    if (t->count_off == 0)  return;
+    for (; x->joint; x = x->joint)
+        recount (t, CastUp( RBTNode, bst, x ));
+}
+
+static void
+rotate (const RBTree* t, RBTNode* x, Bit lowup)
+{
+    BSTNode* a = x->bst.split[lowup ? 0 : 1];
     rotate_BSTNode (&x->bst, lowup);
+    if (t->count_off != 0)
+    {
+        recount (t, x);
+        recount (t, CastUp( RBTNode, bst, a ));
+    }
 }
 
   RBTree
@@ -37,6 +66,20 @@ dflt2_RBTree (RBTNode* sentinel, PosetCmp cmp)
   sentinel->red = 0;
   cmp = dflt3_PosetCmp (offsetof(RBTNode, bst), cmp.off, cmp.fn);
   t.bst = dflt2_BSTree (&sentinel->bst, cmp);
+  t.count_off = 0;
+  return t;
+}
+
+/** Construct a tree which keeps subtree sizes,
+ * allowing select_RBTree() and rank_RBTree().
+ * \param count_off  Offset from each node to its {zuint} subtree size.
+ **/
+  RBTree
+dflt3_RBTree (RBTNode* sentinel, PosetCmp cmp, ptrdiff_t count_off)
+{
+  RBTree t = dflt2_RBTree (sentinel, cmp);
+  Claim2( count_off ,!=, 0 );
+  t.count_off = count_off;
   return t;
 }
 
@@ -46,7 +89,11 @@ init_RBTree (RBTree* t, RBTNode* sentinel, PosetCmp cmp)
   *t = dflt2_RBTree (sentinel, cmp);
 }
 
-static void
+/** Restore red-black properties above a red node {x}.
+ * \return  Whether the root was blackened, which makes the tree's
+ * black height grow by one.
+ **/
+static Bit
 fixup_insert (RBTNode* x, RBTree* t)
 {
     while (1)
@@ -59,12 +106,12 @@ fixup_insert (RBTNode* x, RBTree* t)
         if (root (t, x))
         {
             x->red = Nil;
-            break;
+            return 1;
         }
         b = joint (x);
 
         /* /b/ is black, /x/ is safe to be red!*/
-        if (!b->red)  break;
+        if (!b->red)  return 0;
 
         a = joint (b);
         xside = side_of_BSTNode (&x->bst);
@@ -81,7 +128,7 @@ fixup_insert (RBTNode* x, RBTree* t)
          */
         if (xside == side_of_BSTNode (&b->bst))
         {
-            rotate (a, !xside);
+            rotate (t, a, !xside);
             x->red = Nil;
             x = b;
         }
@@ -97,19 +144,30 @@ fixup_insert (RBTNode* x, RBTree* t)
          */
         else
         {
-            rotate (b, !xside);
+            rotate (t, b, !xside);
             b->red = Nil;
-            rotate (a, xside);
+            rotate (t, a, xside);
         }
     }
 }
 
+/** Restore red-black properties after {x} was inserted as a leaf.
+ * This is for trees which use their own insertion,
+ * such as those from DeclRBTreeT().
+ **/
+  void
+fixup_insert_RBTree (RBTree* t, RBTNode* x)
+{
+  recount_up (t, &x->bst);
+  x->red = Yes;
+  fixup_insert (x, t);
+}
+
     void
 insert_RBTree (RBTree* t, RBTNode* x)
 {
     insert_BSTree (&t->bst, &x->bst);
-    x->red = Yes;
-    fixup_insert (x, t);
+    fixup_insert_RBTree (t, x);
 }
 
 /** If a node matching /x/ exists, return that node.
@@ -121,8 +179,7 @@ ensure_RBTree (RBTree* t, RBTNode* x)
     BSTNode* y = ensure_BSTree (&t->bst, &x->bst);
     if (y == &x->bst)
     {
-        x->red = Yes;
-        fixup_insert (x, t);
+        fixup_insert_RBTree (t, x);
     }
     else
     {
@@ -141,10 +198,18 @@ ensure_RBTree (RBTree* t, RBTNode* x)
 setf_RBTree (RBTree* t, RBTNode* x)
 {
     BSTNode* y = setf_BSTree (&t->bst, &x->bst);
-    if (!y)  return 0;
-    x->red = Yes;
-    fixup_insert (x, t);
-    return CastUp( RBTNode, bst, y );
+    RBTNode* b;
+    if (!y)
+    {
+        fixup_insert_RBTree (t, x);
+        return 0;
+    }
+    /* {x} took the place of {b}, so it takes its color and size too.*/
+    b = CastUp( RBTNode, bst, y );
+    x->red = b->red;
+    if (t->count_off != 0)
+        recount (t, x);
+    return b;
 }
 
 /**
@@ -180,8 +245,8 @@ fixup_remove (RBTNode* y, RBTree* t, Bit side)
      */
     if (x && x->red)
     {
-      rotate (a, !side);
-      rotate (b, side);
+      rotate (t, a, !side);
+      rotate (t, b, side);
       if (b->red)  b->red = 0;
       else         x->red = 0;
       break;
@@ -197,7 +262,7 @@ fixup_remove (RBTNode* y, RBTree* t, Bit side)
      */
     if (b->red)
     {
-      rotate (b, side);
+      rotate (t, b, side);
       break;
     }
 
@@ -211,7 +276,7 @@ fixup_remove (RBTNode* y, RBTree* t, Bit side)
      */
     if (a->red)
     {
-      rotate (b, side);
+      rotate (t, b, side);
       a->red = 0;
       b->red = 1;
       continue;  /* Match case 1 or 2.*/
@@ -227,7 +292,7 @@ fixup_remove (RBTNode* y, RBTree* t, Bit side)
      */
     if (w && w->red)
     {
-      rotate (b, side);
+      rotate (t, b, side);
       w->red = 0;
       break;
     }
@@ -253,6 +318,7 @@ remove_RBTree (RBTree* t, RBTNode* y)
   RBTNode* z;
   Bit side = side_of_BSTNode (&y->bst);
   remove_BSTNode (&y->bst);
+  recount_up (t, y->bst.joint);
   z = split (b, side);
   if (z) {
     /* Recolor the node that replaced {y}.*/
@@ -274,3 +340,282 @@ remove_RBTree (RBTree* t, RBTNode* y)
   }
 }
 
+static RBTNode*
+bulkload_rec (const RBTree* t, RBTNode** nodes, zuint n,
+              zuint depth, zuint red_depth)
+{
+  const zuint m = n / 2;
+  RBTNode* x;
+  if (n == 0)  return 0;
+
+  x = nodes[m];
+  x->red = (depth == red_depth) ? 1 : 0;
+  x->bst.split[0] = 0;
+  x->bst.split[1] = 0;
+  {
+    RBTNode* lo = bulkload_rec (t, nodes, m, depth+1, red_depth);
+    RBTNode* hi = bulkload_rec (t, &nodes[m+1], n-m-1, depth+1, red_depth);
+    if (lo)  join_BSTNode (&x->bst, &lo->bst, 0);
+    if (hi)  join_BSTNode (&x->bst, &hi->bst, 1);
+  }
+  if (t->count_off != 0)
+    *CastOff( zuint, x ,+, t->count_off ) = n;
+  return x;
+}
+
+/** Build a balanced tree from {n} nodes which are already in order.
+ * The tree must be empty.
+ *
+ * Each subtree takes its middle node as root, so every level but the
+ * deepest is full. Nodes on the deepest level are red when that level
+ * is partial, and all others are black.
+ **/
+  void
+bulkload_RBTree (RBTree* t, RBTNode** nodes, zuint n)
+{
+  zuint red_depth = SIZE_MAX;
+  RBTNode* root;
+  Claim( !root_of_BSTree (&t->bst) );
+  if (n == 0)  return;
+
+  if ((n & (n + 1)) != 0) {
+    /* Depth of the deepest level is the floor of lg(n).*/
+    red_depth = 0;
+    while ((n >> (red_depth + 1)) != 0)
+      ++ red_depth;
+  }
+  root = bulkload_rec (t, nodes, n, 0, red_depth);
+  root_fo_BSTree (&t->bst, &root->bst);
+}
+
+/** Get the node with {k} nodes before it.
+ * The tree must keep subtree sizes.
+ * \return  NULL when the tree has no more than {k} nodes.
+ **/
+  RBTNode*
+select_RBTree (RBTree* t, zuint k)
+{
+  BSTNode* y = root_of_BSTree (&t->bst);
+  Claim2( t->count_off ,!=, 0 );
+  while (y)
+  {
+    RBTNode* x = CastUp( RBTNode, bst, y );
+    const zuint n = count_of (t, split (x, 0));
+    if (k == n)  return x;
+    if (k < n)
+    {
+      y = y->split[0];
+    }
+    else
+    {
+      k -= n + 1;
+      y = y->split[1];
+    }
+  }
+  return 0;
+}
+
+/** Count the nodes before {x}.
+ * The tree must keep subtree sizes.
+ **/
+  zuint
+rank_RBTree (const RBTree* t, RBTNode* x)
+{
+  zuint k = count_of (t, split (x, 0));
+  Claim2( t->count_off ,!=, 0 );
+  while (!root (t, x))
+  {
+    if (side_of_BSTNode (&x->bst) == 1)
+      k += 1 + count_of (t, split (joint (x), 0));
+    x = joint (x);
+  }
+  return k;
+}
+
+/** Number of nodes in a tree which keeps subtree sizes.**/
+  zuint
+sz_of_RBTree (const RBTree* t)
+{
+  BSTNode* y = t->bst.sentinel->split[0];
+  Claim2( t->count_off ,!=, 0 );
+  return y ? count_of (t, CastUp( RBTNode, bst, y )) : 0;
+}
+
+static RBTNode*
+root_of (RBTree* t)
+{
+    BSTNode* y = root_of_BSTree (&t->bst);
+    return y ? CastUp( RBTNode, bst, y ) : 0;
+}
+
+/** Number of black nodes on the leftmost path of {x}.**/
+static zuint
+black_height (RBTNode* x)
+{
+    zuint h = 0;
+    for (; x; x = split (x, 0))
+        if (!x->red)  ++h;
+    return h;
+}
+
+/** Make {x} the root of {t}, or empty {t} when {x} is NULL.**/
+static void
+root_fo (RBTree* t, RBTNode* x)
+{
+    if (x)  root_fo_BSTree (&t->bst, &x->bst);
+    else    t->bst.sentinel->split[0] = 0;
+}
+
+/** Make an empty tree which orders nodes like {t}.**/
+static RBTree
+empty_like (const RBTree* t, RBTNode* sentinel)
+{
+    RBTree u = *t;
+    sentinel->red = 0;
+    sentinel->bst.joint = 0;
+    sentinel->bst.split[0] = 0;
+    sentinel->bst.split[1] = 0;
+    u.bst.sentinel = &sentinel->bst;
+    return u;
+}
+
+/** Join {t}, then {k}, then {u} into {t}, leaving {u} empty.
+ * Every key of {t} must be less than that of {k},
+ * which must be less than every key of {u}.
+ *
+ * The trees have black heights {ht} and {hu}.
+ * The shorter tree hangs from the spine of the taller one,
+ * so this takes time proportional to the difference in height.
+ *
+ * \return  Black height of the joined tree.
+ **/
+static zuint
+join3 (RBTree* t, zuint ht, RBTNode* k, RBTree* u, zuint hu)
+{
+    RBTNode* l = root_of (t);
+    RBTNode* r = root_of (u);
+    zuint h;
+
+    /* A red root can be blackened at the cost of one black height.*/
+    if (l && l->red)  { l->red = 0; ++ht; }
+    if (r && r->red)  { r->red = 0; ++hu; }
+
+    if (ht == hu)
+    {
+        k->red = 0;
+        join_BSTNode (&k->bst, l ? &l->bst : 0, 0);
+        join_BSTNode (&k->bst, r ? &r->bst : 0, 1);
+        root_fo (t, k);
+        root_fo (u, 0);
+        recount_up (t, &k->bst);
+        return ht + 1;
+    }
+
+    {
+        /* Descend the inner spine of the taller tree until reaching
+         * a black node {c} (or NULL) as tall as the shorter tree.
+         */
+        const Bit side = (ht > hu) ? 1 : 0;
+        RBTree* tall = side ? t : u;
+        RBTNode* c = side ? l : r;
+        RBTNode* a = 0;
+        h = side ? ht : hu;
+        while (c && (c->red || h > (side ? hu : ht)))
+        {
+            if (!c->red)  --h;
+            a = c;
+            c = split (c, side);
+        }
+        Claim( a );
+        join_BSTNode (&a->bst, &k->bst, side);
+        join_BSTNode (&k->bst, c ? &c->bst : 0, !side);
+        if (side)  join_BSTNode (&k->bst, r ? &r->bst : 0, 1);
+        else       join_BSTNode (&k->bst, l ? &l->bst : 0, 0);
+
+        h = side ? ht : hu;
+        recount_up (tall, &k->bst);
+        k->red = 1;
+        h += fixup_insert (k, tall);
+        if (!side)  root_fo (t, root_of (u));
+        root_fo (u, 0);
+    }
+    return h;
+}
+
+/** Split the subtree under {x}, of black height {hx},
+ * into {t} (keys less than {key}) and {u} (the rest).
+ * Both trees must start empty.
+ **/
+static void
+split_rec (RBTree* t, zuint* ht, RBTree* u, zuint* hu,
+           RBTNode* x, zuint hx, const void* key)
+{
+    RBTNode sentinel;
+    RBTree side_tree;
+    const zuint hc = hx - (x && !x->red ? 1 : 0);
+
+    if (!x)
+    {
+        *ht = 0;
+        *hu = 0;
+        return;
+    }
+
+    side_tree = empty_like (t, &sentinel);
+    if (poset_cmp_lhs (t->bst.cmp, key, &x->bst) <= 0)
+    {
+        /* {x} and its hi subtree belong in {u}.*/
+        RBTNode* b = split (x, 1);
+        split_rec (t, ht, u, hu, split (x, 0), hc, key);
+        root_fo (&side_tree, b);
+        *hu = join3 (u, *hu, x, &side_tree, hc);
+    }
+    else
+    {
+        /* {x} and its lo subtree belong in {t}.*/
+        RBTNode* a = split (x, 0);
+        split_rec (t, ht, u, hu, split (x, 1), hc, key);
+        root_fo (&side_tree, a);
+        *ht = join3 (&side_tree, hc, x, t, *ht);
+        root_fo (t, root_of (&side_tree));
+    }
+}
+
+/** Split {t} so that it keeps the nodes whose keys are less than {key}
+ * and {u} takes the rest.
+ * {u} must be empty and order nodes the same way as {t},
+ * with the same {count_off}.
+ * This takes O(log n) time.
+ **/
+  void
+split_RBTree (RBTree* t, const void* key, RBTree* u)
+{
+  RBTNode* x = root_of (t);
+  zuint ht, hu;
+  Claim( !root_of (u) );
+  Claim2( t->count_off ,==, u->count_off );
+  root_fo (t, 0);
+  split_rec (t, &ht, u, &hu, x, black_height (x), key);
+}
+
+/** Move every node of {u} into {t}, leaving {u} empty.
+ * Every key of {t} must be less than every key of {u}.
+ * This takes O(log n) time.
+ **/
+  void
+join_RBTree (RBTree* t, RBTree* u)
+{
+  RBTNode* k;
+  Claim2( t->count_off ,==, u->count_off );
+  if (!root_of (u))  return;
+  if (!root_of (t))
+  {
+    root_fo (t, root_of (u));
+    root_fo (u, 0);
+    return;
+  }
+  /* Use the least node of {u} as the pivot.*/
+  k = CastUp( RBTNode, bst, beg_BSTree (&u->bst) );
+  remove_RBTree (u, k);
+  join3 (t, black_height (root_of (t)), k, u, black_height (root_of (u)));
+}
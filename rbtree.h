@@ -18,10 +18,16 @@ struct RBTNode
 struct RBTree
 {
     BSTree bst;
+    /** Offset from each node to its subtree size,
+     * or zero when sizes are not kept.
+     **/
+    ptrdiff_t count_off;
 };
 
 RBTree
 dflt2_RBTree (RBTNode* sentinel, PosetCmp cmp);
+RBTree
+dflt3_RBTree (RBTNode* sentinel, PosetCmp cmp, ptrdiff_t count_off);
 void
 init_RBTree (RBTree* t, RBTNode* sentinel, PosetCmp cmp);
 void
@@ -32,6 +38,20 @@ RBTNode*
 setf_RBTree (RBTree* t, RBTNode* x);
 void
 remove_RBTree (RBTree* t, RBTNode* y);
+void
+bulkload_RBTree (RBTree* t, RBTNode** nodes, zuint n);
+void
+fixup_insert_RBTree (RBTree* t, RBTNode* x);
+RBTNode*
+select_RBTree (RBTree* t, zuint k);
+zuint
+rank_RBTree (const RBTree* t, RBTNode* x);
+zuint
+sz_of_RBTree (const RBTree* t);
+void
+split_RBTree (RBTree* t, const void* key, RBTree* u);
+void
+join_RBTree (RBTree* t, RBTree* u);
 
 qual_inline
     void
@@ -41,5 +61,40 @@ plac_RBTNode (RBTNode* a, RBTNode* b)
     plac_BSTNode (&a->bst, &b->bst);
 }
 
+/** Declare insertion functions for a red-black tree whose keys
+ * have a known type. DeclBSTreeT() must already be used with {Name}
+ * and {KeyT}.
+ **/
+#define DeclRBTreeT( Name, KeyT ) \
+qual_inline \
+  RBTNode* \
+find_##Name##_RBTree (RBTree* t, const KeyT* key) \
+{ \
+  BSTNode* y = find_##Name##_BSTree (&t->bst, key); \
+  return y ? CastUp( RBTNode, bst, y ) : 0; \
+} \
+qual_inline \
+  void \
+insert_##Name##_RBTree (RBTree* t, RBTNode* x) \
+{ \
+  insert_##Name##_BSTree (&t->bst, &x->bst); \
+  fixup_insert_RBTree (t, x); \
+} \
+qual_inline \
+  RBTNode* \
+ensure_##Name##_RBTree (RBTree* t, RBTNode* x) \
+{ \
+  BSTNode* y = ensure_##Name##_BSTree (&t->bst, &x->bst); \
+  if (y == &x->bst) \
+    fixup_insert_RBTree (t, x); \
+  return CastUp( RBTNode, bst, y ); \
+}
+
+DeclRBTreeT( int, int )
+DeclRBTreeT( uint, uint )
+DeclRBTreeT( zuint, zuint )
+DeclRBTreeT( MemLoc, void* )
+DeclRBTreeT( cstr, char* )
+
 #endif
 
@@ -0,0 +1,862 @@
+/**
+ * \file roarbittable.c
+ * Compressed bit table.
+ **/
+#include "roarbittable.h"
+
+#define NBits  ((uint) NBits_BitTableEl)
+#define NEls  ((uint) NEls_RoarBitTableCtr)
+#define NCtrBits  ((uint) NBits_RoarBitTableCtr)
+
+static
+  RoarBitTableCtr
+dflt1_RoarBitTableCtr (zuint key)
+{
+  RoarBitTableCtr x;
+  x.key = key;
+  x.card = 0;
+  x.kind = RoarBitTableCtr_Array;
+  InitTable( x.a );
+  x.bt = dflt_BitTable ();
+  return x;
+}
+
+static
+  void
+lose_RoarBitTableCtr (RoarBitTableCtr* x)
+{
+  LoseTable( x->a );
+  lose_BitTable (&x->bt);
+}
+
+/** Number of bits of chunk {key} that lie within the table.**/
+static
+  uint
+lim_of_key (const RoarBitTable* rbt, zuint key)
+{
+  const zuint off = key * NCtrBits;
+  if (rbt->sz - off >= NCtrBits)
+    return NCtrBits;
+  return (uint) (rbt->sz - off);
+}
+
+/** Index of the first container whose key is not less than {key}.**/
+static
+  zuint
+lbidx_RoarBitTable (const RoarBitTable* rbt, zuint key)
+{
+  zuint lo = 0;
+  zuint hi = rbt->ctrs.sz;
+  while (lo < hi)
+  {
+    const zuint mid = lo + (hi - lo) / 2;
+    if (rbt->ctrs.s[mid].key < key)  lo = mid + 1;
+    else                             hi = mid;
+  }
+  return lo;
+}
+
+/** Index of the first array element not less than {v}.**/
+static
+  uint
+lbidx_uint16 (const uint16_t* s, uint n, uint v)
+{
+  uint lo = 0;
+  uint hi = n;
+  while (lo < hi)
+  {
+    const uint mid = lo + (hi - lo) / 2;
+    if (s[mid] < v)  lo = mid + 1;
+    else             hi = mid;
+  }
+  return lo;
+}
+
+/** Index of the run containing {v} or the last run before it.
+ * \return  The number of runs if no run begins at or before {v}.
+ **/
+static
+  uint
+runidx_RoarBitTableCtr (const RoarBitTableCtr* x, uint v)
+{
+  const uint nruns = (uint) (x->a.sz / 2);
+  uint lo = 0;
+  uint hi = nruns;
+  while (lo < hi)
+  {
+    const uint mid = lo + (hi - lo) / 2;
+    if (x->a.s[2*mid] <= v)  lo = mid + 1;
+    else                     hi = mid;
+  }
+  return (lo == 0 ? nruns : lo - 1);
+}
+
+static
+  void
+setrange_words (BitTableEl* w, uint beg, uint end)
+{
+  uint p = beg / NBits;
+  const uint q = end / NBits;
+  const BitTableEl lo = ~(BitTableEl)0 << (beg % NBits);
+  const BitTableEl hi = ~(BitTableEl)0 >> (NBits - 1 - end % NBits);
+  if (p == q)
+  {
+    w[p] |= lo & hi;
+    return;
+  }
+  w[p] |= lo;
+  for (++p; p < q; ++p)
+    w[p] = ~(BitTableEl)0;
+  w[q] |= hi;
+}
+
+/** Clear all bits at and above {lim}.**/
+static
+  void
+mask_words (BitTableEl* w, uint lim)
+{
+  uint p = lim / NBits;
+  if (lim >= NCtrBits)  return;
+  w[p] &= ~(~(BitTableEl)0 << (lim % NBits));
+  for (++p; p < NEls; ++p)
+    w[p] = 0;
+}
+
+static
+  uint
+popcount_words (const BitTableEl* w)
+{
+  uint n = 0;
+  uint i;
+  UFor( i, NEls )
+    n += popcount_BitTableEl (w[i]);
+  return n;
+}
+
+static
+  uint
+nruns_words (const BitTableEl* w)
+{
+  uint n = 0;
+  BitTableEl carry = 0;
+  uint i;
+  UFor( i, NEls )
+  {
+    n += popcount_BitTableEl (w[i] & ~((w[i] << 1) | carry));
+    carry = w[i] >> (NBits - 1);
+  }
+  return n;
+}
+
+/** Index of the first bit at or after {v} that matches {val}.
+ * \return  NCtrBits when no such bit exists.
+ **/
+static
+  uint
+nextb_words (const BitTableEl* w, uint v, Bit val)
+{
+  uint p = v / NBits;
+  BitTableEl x;
+  if (v >= NCtrBits)  return NCtrBits;
+  x = (val ? w[p] : ~w[p]) & (~(BitTableEl)0 << (v % NBits));
+  while (x == 0)
+  {
+    if (++p == NEls)  return NCtrBits;
+    x = (val ? w[p] : ~w[p]);
+  }
+  return p * NBits + lsbidx_BitTableEl (x);
+}
+
+/** Get the bitmap words of a container.
+ * \param buf  Scratch space, used unless {x} is already a bitmap.
+ *   A null {x} is treated as an empty container.
+ **/
+static
+  const BitTableEl*
+words_of_RoarBitTableCtr (const RoarBitTableCtr* x, BitTableEl* buf)
+{
+  uint i;
+  if (x && x->kind == RoarBitTableCtr_Bitmap)
+    return x->bt.s;
+
+  memset (buf, 0, NEls * sizeof (BitTableEl));
+  if (!x)  return buf;
+
+  if (x->kind == RoarBitTableCtr_Array)
+  {
+    UFor( i, x->a.sz )
+    {
+      const uint v = x->a.s[i];
+      buf[v / NBits] |= (BitTableEl)1 << (v % NBits);
+    }
+  }
+  else
+  {
+    for (i = 0; i < x->a.sz; i += 2)
+      setrange_words (buf, x->a.s[i], x->a.s[i+1]);
+  }
+  return buf;
+}
+
+/** Choose the representation of a container given its bits.
+ *
+ * {w} may be the container's own bitmap.
+ *
+ * \param runs  Whether a run container may be chosen.
+ *   Containers that are about to be modified one bit at a time
+ *   should not be runs.
+ **/
+static
+  void
+fo_words_RoarBitTableCtr (RoarBitTableCtr* x, const BitTableEl* w,
+                          uint card, bool runs)
+{
+  const zuint array_sz = card * sizeof (uint16_t);
+  const zuint bitmap_sz = NEls * sizeof (BitTableEl);
+  const zuint run_sz = (runs ? 2 * nruns_words (w) * sizeof (uint16_t)
+                        : SIZE_MAX);
+
+  x->card = card;
+  if (run_sz < array_sz && run_sz < bitmap_sz)
+  {
+    uint v = nextb_words (w, 0, 1);
+    ResizeTable( x->a, run_sz / sizeof (uint16_t) );
+    {uint i = 0;for (; v < NCtrBits; i += 2) {
+      const uint end = nextb_words (w, v, 0);
+      x->a.s[i] = (uint16_t) v;
+      x->a.s[i+1] = (uint16_t) (end - 1);
+      v = nextb_words (w, end, 1);
+    }}
+    x->kind = RoarBitTableCtr_Run;
+  }
+  else if (card <= MaxArraySz_RoarBitTableCtr)
+  {
+    uint n = 0;
+    uint p;
+    ResizeTable( x->a, card );
+    UFor( p, NEls )
+    {
+      BitTableEl y = w[p];
+      while (y != 0)
+      {
+        x->a.s[n++] = (uint16_t) (p * NBits + lsbidx_BitTableEl (y));
+        y &= y - 1;
+      }
+    }
+    x->kind = RoarBitTableCtr_Array;
+  }
+  else
+  {
+    if (!x->bt.s)
+      x->bt = cons1_BitTable (NCtrBits);
+    if (x->bt.s != w)
+      memcpy (x->bt.s, w, NEls * sizeof (BitTableEl));
+    LoseTable( x->a );
+    InitTable( x->a );
+    x->kind = RoarBitTableCtr_Bitmap;
+    return;
+  }
+  lose_BitTable (&x->bt);
+  x->bt = dflt_BitTable ();
+}
+
+static
+  Bit
+ck_RoarBitTableCtr (const RoarBitTableCtr* x, uint v)
+{
+  switch (x->kind)
+  {
+  case RoarBitTableCtr_Array:
+    {
+      const uint i = lbidx_uint16 (x->a.s, (uint) x->a.sz, v);
+      return (i < x->a.sz && x->a.s[i] == v);
+    }
+  case RoarBitTableCtr_Bitmap:
+    return ck_BitTable (x->bt, v);
+  case RoarBitTableCtr_Run:
+    {
+      const uint r = runidx_RoarBitTableCtr (x, v);
+      return (2*r < x->a.sz && v <= x->a.s[2*r+1]);
+    }
+  }
+  return 0;
+}
+
+/** First bit at or after {v} that is set.
+ * \return  NCtrBits when no such bit exists.
+ **/
+static
+  uint
+nextge_RoarBitTableCtr (const RoarBitTableCtr* x, uint v)
+{
+  switch (x->kind)
+  {
+  case RoarBitTableCtr_Array:
+    {
+      const uint i = lbidx_uint16 (x->a.s, (uint) x->a.sz, v);
+      return (i < x->a.sz ? x->a.s[i] : NCtrBits);
+    }
+  case RoarBitTableCtr_Bitmap:
+    return nextb_words (x->bt.s, v, 1);
+  case RoarBitTableCtr_Run:
+    {
+      uint r = runidx_RoarBitTableCtr (x, v);
+      if (2*r < x->a.sz && v <= x->a.s[2*r+1])
+        return v;
+      r = (2*r < x->a.sz ? r+1 : 0);
+      return (2*r < x->a.sz ? x->a.s[2*r] : NCtrBits);
+    }
+  }
+  return NCtrBits;
+}
+
+static
+  Bit
+setb_RoarBitTableCtr (RoarBitTableCtr* x, uint v, Bit b)
+{
+  if (x->kind == RoarBitTableCtr_Array)
+  {
+    const uint i = lbidx_uint16 (x->a.s, (uint) x->a.sz, v);
+    const Bit old = (i < x->a.sz && x->a.s[i] == v);
+    if (old == b)  return old;
+    if (b && x->card == MaxArraySz_RoarBitTableCtr)
+    {
+      /* Becomes a bitmap.*/
+      BitTableEl* buf = AllocT( BitTableEl, NEls );
+      words_of_RoarBitTableCtr (x, buf);
+      buf[v / NBits] |= (BitTableEl)1 << (v % NBits);
+      fo_words_RoarBitTableCtr (x, buf, x->card + 1, false);
+      free (buf);
+    }
+    else if (b)
+    {
+      GrowTable( x->a, 1 );
+      memmove (&x->a.s[i+1], &x->a.s[i],
+               (x->a.sz - 1 - i) * sizeof (uint16_t));
+      x->a.s[i] = (uint16_t) v;
+      x->card += 1;
+    }
+    else
+    {
+      memmove (&x->a.s[i], &x->a.s[i+1],
+               (x->a.sz - 1 - i) * sizeof (uint16_t));
+      MPopTable( x->a, 1 );
+      x->card -= 1;
+    }
+    return old;
+  }
+
+  if (x->kind == RoarBitTableCtr_Bitmap)
+  {
+    if (setb_BitTable (x->bt, v, b) == b)  return b;
+    if (b)
+    {
+      x->card += 1;
+    }
+    else
+    {
+      x->card -= 1;
+      if (x->card <= MaxArraySz_RoarBitTableCtr)
+        fo_words_RoarBitTableCtr (x, x->bt.s, x->card, false);
+    }
+    return !b;
+  }
+
+  /* Run containers are only made by bulk operations,
+   * so turn this one back into an array or bitmap.
+   */
+  if (ck_RoarBitTableCtr (x, v) == b)  return b;
+  {
+    BitTableEl* buf = AllocT( BitTableEl, NEls );
+    words_of_RoarBitTableCtr (x, buf);
+    if (b)  buf[v / NBits] |=  ((BitTableEl)1 << (v % NBits));
+    else    buf[v / NBits] &= ~((BitTableEl)1 << (v % NBits));
+    fo_words_RoarBitTableCtr (x, buf, b ? x->card + 1 : x->card - 1, false);
+    free (buf);
+  }
+  return !b;
+}
+
+static
+  RoarBitTableCtr
+full_RoarBitTableCtr (zuint key, uint lim)
+{
+  RoarBitTableCtr x = dflt1_RoarBitTableCtr (key);
+  x.kind = RoarBitTableCtr_Run;
+  x.card = lim;
+  ResizeTable( x.a, 2 );
+  x.a.s[0] = 0;
+  x.a.s[1] = (uint16_t) (lim - 1);
+  return x;
+}
+
+  void
+lose_RoarBitTable (RoarBitTable* rbt)
+{
+  zuint i;
+  UFor( i, rbt->ctrs.sz )
+    lose_RoarBitTableCtr (&rbt->ctrs.s[i]);
+  LoseTable( rbt->ctrs );
+  InitTable( rbt->ctrs );
+}
+
+  void
+wipe_RoarBitTable (RoarBitTable* rbt, Bit val)
+{
+  const zuint nkeys = CeilQuot( rbt->sz, NCtrBits );
+  lose_RoarBitTable (rbt);
+  if (!val)  return;
+  {zuint key = 0;for (; key < nkeys; ++key) {
+    PushTable( rbt->ctrs, full_RoarBitTableCtr (key, lim_of_key (rbt, key)) );
+  }}
+}
+
+/** Resize the table.
+ * New bits are zero.
+ **/
+  void
+size_RoarBitTable (RoarBitTable* rbt, zuint n)
+{
+  const zuint nkeys = CeilQuot( n, NCtrBits );
+  zuint i;
+  if (n >= rbt->sz)
+  {
+    rbt->sz = n;
+    return;
+  }
+  rbt->sz = n;
+  i = lbidx_RoarBitTable (rbt, nkeys);
+  while (rbt->ctrs.sz > i)
+  {
+    lose_RoarBitTableCtr (TopTable( rbt->ctrs ));
+    MPopTable( rbt->ctrs, 1 );
+  }
+
+  if (i > 0 && rbt->ctrs.s[i-1].key + 1 == nkeys &&
+      lim_of_key (rbt, nkeys - 1) < NCtrBits)
+  {
+    RoarBitTableCtr* x = &rbt->ctrs.s[i-1];
+    BitTableEl* buf = AllocT( BitTableEl, NEls );
+    const BitTableEl* w = words_of_RoarBitTableCtr (x, buf);
+    if (w != buf)
+      memcpy (buf, w, NEls * sizeof (BitTableEl));
+    mask_words (buf, lim_of_key (rbt, x->key));
+    x->card = popcount_words (buf);
+    if (x->card > 0)
+    {
+      fo_words_RoarBitTableCtr (x, buf, x->card, true);
+    }
+    else
+    {
+      lose_RoarBitTableCtr (x);
+      MPopTable( rbt->ctrs, 1 );
+    }
+    free (buf);
+  }
+}
+
+/** Pick the smallest representation for every container.
+ * This is when run containers are formed from bits that were set
+ * one at a time.
+ **/
+  void
+pack_RoarBitTable (RoarBitTable* rbt)
+{
+  BitTableEl* buf = AllocT( BitTableEl, NEls );
+  zuint i;
+  UFor( i, rbt->ctrs.sz )
+  {
+    RoarBitTableCtr* x = &rbt->ctrs.s[i];
+    fo_words_RoarBitTableCtr (x, words_of_RoarBitTableCtr (x, buf),
+                              x->card, true);
+    PackTable( x->a );
+  }
+  PackTable( rbt->ctrs );
+  free (buf);
+}
+
+/** Check if a bit is set (to one).**/
+  Bit
+ck_RoarBitTable (const RoarBitTable* rbt, zuint i)
+{
+  const zuint key = i / NCtrBits;
+  const zuint idx = lbidx_RoarBitTable (rbt, key);
+  if (idx == rbt->ctrs.sz || rbt->ctrs.s[idx].key != key)
+    return 0;
+  return ck_RoarBitTableCtr (&rbt->ctrs.s[idx], (uint) (i % NCtrBits));
+}
+
+/** Set a bit to one.
+ * \return  The old value of the bit.
+ **/
+  Bit
+set1_RoarBitTable (RoarBitTable* rbt, zuint i)
+{
+  const zuint key = i / NCtrBits;
+  const zuint idx = lbidx_RoarBitTable (rbt, key);
+  RoarBitTableCtr* x;
+
+  Claim2( i ,<, rbt->sz );
+  if (idx < rbt->ctrs.sz && rbt->ctrs.s[idx].key == key)
+    return setb_RoarBitTableCtr (&rbt->ctrs.s[idx], (uint) (i % NCtrBits), 1);
+
+  GrowTable( rbt->ctrs, 1 );
+  memmove (&rbt->ctrs.s[idx+1], &rbt->ctrs.s[idx],
+           (rbt->ctrs.sz - 1 - idx) * sizeof (RoarBitTableCtr));
+  x = &rbt->ctrs.s[idx];
+  *x = dflt1_RoarBitTableCtr (key);
+  PushTable( x->a, (uint16_t) (i % NCtrBits) );
+  x->card = 1;
+  return 0;
+}
+
+/** Set a bit to zero.
+ * \return  The old value of the bit.
+ **/
+  Bit
+set0_RoarBitTable (RoarBitTable* rbt, zuint i)
+{
+  const zuint key = i / NCtrBits;
+  const zuint idx = lbidx_RoarBitTable (rbt, key);
+  RoarBitTableCtr* x;
+
+  if (idx == rbt->ctrs.sz || rbt->ctrs.s[idx].key != key)
+    return 0;
+
+  x = &rbt->ctrs.s[idx];
+  if (!setb_RoarBitTableCtr (x, (uint) (i % NCtrBits), 0))
+    return 0;
+
+  if (x->card == 0)
+  {
+    lose_RoarBitTableCtr (x);
+    memmove (&rbt->ctrs.s[idx], &rbt->ctrs.s[idx+1],
+             (rbt->ctrs.sz - 1 - idx) * sizeof (RoarBitTableCtr));
+    MPopTable( rbt->ctrs, 1 );
+  }
+  return 1;
+}
+
+  zuint
+count_RoarBitTable (const RoarBitTable* rbt)
+{
+  zuint n = 0;
+  zuint i;
+  UFor( i, rbt->ctrs.sz )
+    n += rbt->ctrs.s[i].card;
+  return n;
+}
+
+/** First set bit at or after {i}, or SIZE_MAX.**/
+static
+  zuint
+nextge_RoarBitTable (const RoarBitTable* rbt, zuint i)
+{
+  zuint idx = lbidx_RoarBitTable (rbt, i / NCtrBits);
+  for (; idx < rbt->ctrs.sz; ++idx)
+  {
+    const RoarBitTableCtr* x = &rbt->ctrs.s[idx];
+    const zuint off = x->key * NCtrBits;
+    const uint v = nextge_RoarBitTableCtr (x, (off < i ? (uint) (i - off) : 0));
+    if (v < NCtrBits)
+      return off + v;
+  }
+  return SIZE_MAX;
+}
+
+  zuint
+next_RoarBitTable (const RoarBitTable* rbt, zuint idx)
+{
+  if (idx + 1 >= rbt->sz)  return SIZE_MAX;
+  return nextge_RoarBitTable (rbt, idx + 1);
+}
+
+  zuint
+beg_RoarBitTable (const RoarBitTable* rbt)
+{
+  return nextge_RoarBitTable (rbt, 0);
+}
+
+/** Truth table of a BitOp.
+ * Bit (2*a + b) holds the result for bits {a} and {b}.
+ **/
+static
+  uint
+truth_of_BitOp (BitOp op)
+{
+  const BitTableEl a = 0xC;
+  const BitTableEl b = 0xA;
+  BitTableEl c = 0;
+#define DoCase( OP ) \
+  case BitOp_##OP: \
+    c = Do_BitOp_##OP( a, b ); \
+    break
+
+  switch (op)
+  {
+  case BitOp_NIL:
+    c = 0;
+    break;
+  DoCase( NOR );
+  DoCase( NOT1 );
+  DoCase( NIMP );
+  DoCase( NOT0 );
+  DoCase( XOR );
+  DoCase( NAND );
+  DoCase( AND );
+  DoCase( XNOR );
+  DoCase( IDEN1 );
+  DoCase( IMP );
+  DoCase( IDEN0 );
+  DoCase( OR );
+  case BitOp_YES:
+    c = ~(BitTableEl)0;
+    break;
+  case NBitOps:
+    Claim(0);
+    break;
+  }
+#undef DoCase
+  return (uint) (c & 0xF);
+}
+
+/** Apply {op} to one chunk.
+ * \param x  Container from the first operand, may be null.
+ * \param y  Container from the second operand, may be null.
+ * \param z  Result, whose card is zero if no bits are set.
+ * \param bufs  Scratch space for three bitmaps.
+ **/
+static
+  void
+op_RoarBitTableCtr (RoarBitTableCtr* z, BitOp op, uint tt, uint lim,
+                    const RoarBitTableCtr* x, const RoarBitTableCtr* y,
+                    BitTableEl* bufs)
+{
+  const uint nx = (x ? x->card : 0);
+  const uint ny = (y ? y->card : 0);
+
+  if ((tt & 1) == 0 &&
+      (!x || x->kind == RoarBitTableCtr_Array) &&
+      (!y || y->kind == RoarBitTableCtr_Array) &&
+      nx + ny <= MaxArraySz_RoarBitTableCtr)
+  {
+    /* Merge two sorted arrays.*/
+    const uint16_t* xs = (x ? x->a.s : 0);
+    const uint16_t* ys = (y ? y->a.s : 0);
+    uint i = 0, j = 0, n = 0;
+    ResizeTable( z->a, nx + ny );
+    while (i < nx || j < ny)
+    {
+      uint v;
+      uint ab;
+      if (j == ny || (i < nx && xs[i] < ys[j]))
+      {
+        v = xs[i++];
+        ab = 2;
+      }
+      else if (i == nx || ys[j] < xs[i])
+      {
+        v = ys[j++];
+        ab = 1;
+      }
+      else
+      {
+        v = xs[i++];
+        ++j;
+        ab = 3;
+      }
+      if (0 != (tt & (1 << ab)))
+        z->a.s[n++] = (uint16_t) v;
+    }
+    ResizeTable( z->a, n );
+    z->card = n;
+    z->kind = RoarBitTableCtr_Array;
+    return;
+  }
+
+  {
+    BitTableEl* c = &bufs[2*NEls];
+    op2_BitTableEl (c, op,
+                    words_of_RoarBitTableCtr (x, &bufs[0]),
+                    words_of_RoarBitTableCtr (y, &bufs[NEls]),
+                    NEls);
+    mask_words (c, lim);
+    z->card = popcount_words (c);
+    if (z->card > 0)
+      fo_words_RoarBitTableCtr (z, c, z->card, true);
+  }
+}
+
+/** Apply a BitOp, as op2_BitTable() does.
+ * {c} may be the same table as {a} or {b}.
+ **/
+  void
+op2_RoarBitTable (RoarBitTable* c, BitOp op,
+                  const RoarBitTable* a, const RoarBitTable* b)
+{
+  const uint tt = truth_of_BitOp (op);
+  const zuint nkeys = CeilQuot( a->sz, NCtrBits );
+  BitTableEl* bufs = AllocT( BitTableEl, 3*NEls );
+  RoarBitTable d = dflt1_RoarBitTable (a->sz);
+  zuint ia = 0, ib = 0;
+  zuint key = 0;
+
+  Claim2( a->sz ,==, b->sz );
+
+  while (true)
+  {
+    const RoarBitTableCtr* x = 0;
+    const RoarBitTableCtr* y = 0;
+
+    if ((tt & 1) == 0)
+    {
+      /* Chunks that are empty in both operands stay empty.*/
+      if (ia == a->ctrs.sz && ib == b->ctrs.sz)  break;
+      if (ib == b->ctrs.sz)       key = a->ctrs.s[ia].key;
+      else if (ia == a->ctrs.sz)  key = b->ctrs.s[ib].key;
+      else if (a->ctrs.s[ia].key < b->ctrs.s[ib].key)
+        key = a->ctrs.s[ia].key;
+      else
+        key = b->ctrs.s[ib].key;
+    }
+    else if (key == nkeys)
+    {
+      break;
+    }
+
+    if (ia < a->ctrs.sz && a->ctrs.s[ia].key == key)
+      x = &a->ctrs.s[ia++];
+    if (ib < b->ctrs.sz && b->ctrs.s[ib].key == key)
+      y = &b->ctrs.s[ib++];
+
+    if (!x && !y)
+    {
+      PushTable( d.ctrs, full_RoarBitTableCtr (key, lim_of_key (a, key)) );
+    }
+    else
+    {
+      RoarBitTableCtr z = dflt1_RoarBitTableCtr (key);
+      op_RoarBitTableCtr (&z, op, tt, lim_of_key (a, key), x, y, bufs);
+      if (z.card > 0)
+        PushTable( d.ctrs, z );
+      else
+        lose_RoarBitTableCtr (&z);
+    }
+    key += 1;
+  }
+
+  free (bufs);
+  lose_RoarBitTable (c);
+  *c = d;
+}
+
+/** Fold over the result of a BitOp, as fold_map2_BitTable() does.**/
+  Bit
+fold_map2_RoarBitTable (BitOp fold_op, BitOp map_op,
+                        const RoarBitTable* a, const RoarBitTable* b)
+{
+  const uint tt = truth_of_BitOp (map_op);
+  const zuint nkeys = CeilQuot( a->sz, NCtrBits );
+  BitTableEl* bufs = AllocT( BitTableEl, 3*NEls );
+  zuint ia = 0, ib = 0;
+  zuint nboth = 0;
+  Bit ret = (fold_op == BitOp_AND);
+
+  Claim2( a->sz ,==, b->sz );
+  Claim( fold_op == BitOp_AND || fold_op == BitOp_OR );
+
+  while (ia < a->ctrs.sz || ib < b->ctrs.sz)
+  {
+    const RoarBitTableCtr* x = 0;
+    const RoarBitTableCtr* y = 0;
+    RoarBitTableCtr z;
+    zuint key;
+    uint lim;
+
+    if (ib == b->ctrs.sz)       key = a->ctrs.s[ia].key;
+    else if (ia == a->ctrs.sz)  key = b->ctrs.s[ib].key;
+    else if (a->ctrs.s[ia].key < b->ctrs.s[ib].key)
+      key = a->ctrs.s[ia].key;
+    else
+      key = b->ctrs.s[ib].key;
+
+    if (ia < a->ctrs.sz && a->ctrs.s[ia].key == key)
+      x = &a->ctrs.s[ia++];
+    if (ib < b->ctrs.sz && b->ctrs.s[ib].key == key)
+      y = &b->ctrs.s[ib++];
+    nboth += 1;
+
+    lim = lim_of_key (a, key);
+    z = dflt1_RoarBitTableCtr (key);
+    op_RoarBitTableCtr (&z, map_op, tt, lim, x, y, bufs);
+    if (fold_op == BitOp_AND && z.card < lim)  ret = 0;
+    if (fold_op == BitOp_OR  && z.card > 0)    ret = 1;
+    lose_RoarBitTableCtr (&z);
+    if (ret != (fold_op == BitOp_AND))  break;
+  }
+  free (bufs);
+
+  /* Chunks empty in both operands map to a constant.*/
+  if (ret == (fold_op == BitOp_AND) && nboth < nkeys)
+    ret = (tt & 1);
+  return ret;
+}
+
+  void
+copy_BitTable_RoarBitTable (BitTable* bt, const RoarBitTable* rbt)
+{
+  const zuint nels = CeilQuot( rbt->sz, NBits_BitTableEl );
+  BitTableEl* buf = AllocT( BitTableEl, NEls );
+  zuint i;
+
+  size_fo_BitTable (bt, rbt->sz);
+  wipe_BitTable (*bt, 0);
+
+  UFor( i, rbt->ctrs.sz )
+  {
+    const RoarBitTableCtr* x = &rbt->ctrs.s[i];
+    const zuint off = x->key * NEls;
+    const zuint n = (nels - off < NEls ? nels - off : NEls);
+    memcpy (&bt->s[off], words_of_RoarBitTableCtr (x, buf),
+            n * sizeof (BitTableEl));
+  }
+  free (buf);
+}
+
+  void
+copy_RoarBitTable_BitTable (RoarBitTable* rbt, const BitTable bt)
+{
+  const zuint nels = CeilQuot( bt.sz, NBits_BitTableEl );
+  const zuint nkeys = CeilQuot( bt.sz, NCtrBits );
+  BitTableEl* buf = AllocT( BitTableEl, NEls );
+  zuint key;
+
+  lose_RoarBitTable (rbt);
+  rbt->sz = bt.sz;
+
+  UFor( key, nkeys )
+  {
+    const zuint off = key * NEls;
+    const uint lim = lim_of_key (rbt, key);
+    const BitTableEl* w = &bt.s[off];
+    uint card;
+
+    if (lim < NCtrBits)
+    {
+      /* Don't trust bits past the end of {bt}.*/
+      memset (buf, 0, NEls * sizeof (BitTableEl));
+      memcpy (buf, w, (nels - off) * sizeof (BitTableEl));
+      mask_words (buf, lim);
+      w = buf;
+    }
+
+    card = popcount_words (w);
+    if (card > 0)
+    {
+      DeclGrow1Table( RoarBitTableCtr, x, rbt->ctrs );
+      *x = dflt1_RoarBitTableCtr (key);
+      fo_words_RoarBitTableCtr (x, w, card, true);
+    }
+  }
+  free (buf);
+}
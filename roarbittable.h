@@ -0,0 +1,120 @@
+/**
+ * \file roarbittable.h
+ * Compressed bit table.
+ *
+ * The index space is cut into chunks of 2^16 bits.
+ * Each nonempty chunk is held by a container which is whichever of
+ * a sorted array, a plain bitmap, or a list of runs takes the least memory.
+ * Empty chunks take no memory at all.
+ **/
+#ifndef RoarBitTable_H_
+#define RoarBitTable_H_
+#include "bittable.h"
+
+typedef struct RoarBitTableCtr RoarBitTableCtr;
+typedef struct RoarBitTable RoarBitTable;
+
+#define NBits_RoarBitTableCtr  ((zuint) 1 << 16)
+#define NEls_RoarBitTableCtr  (NBits_RoarBitTableCtr / NBits_BitTableEl)
+/** Array containers holding more bits than this become bitmaps.**/
+#define MaxArraySz_RoarBitTableCtr  4096
+
+enum RoarBitTableCtrKind
+{
+  RoarBitTableCtr_Array,
+  RoarBitTableCtr_Bitmap,
+  RoarBitTableCtr_Run
+};
+typedef enum RoarBitTableCtrKind RoarBitTableCtrKind;
+
+#define DeclTableT_uint16
+DeclTableT( uint16, uint16_t );
+
+struct RoarBitTableCtr
+{
+  zuint key;  /**< Chunk index (bit index divided by 2^16).**/
+  uint card;  /**< Number of bits set.**/
+  RoarBitTableCtrKind kind;
+  /** Sorted bit offsets (Array) or inclusive begin/end pairs (Run).**/
+  TableT(uint16) a;
+  /** All 2^16 bits of the chunk (Bitmap).**/
+  BitTable bt;
+};
+DeclTableT( RoarBitTableCtr, RoarBitTableCtr );
+
+struct RoarBitTable
+{
+  TableT(RoarBitTableCtr) ctrs;  /**< Nonempty chunks, sorted by key.**/
+  zuint sz;  /**< Number of bits, as in BitTable.**/
+};
+#define DEFAULT_RoarBitTable  { DEFAULT_Table, 0 }
+
+void
+lose_RoarBitTable (RoarBitTable* rbt);
+void
+wipe_RoarBitTable (RoarBitTable* rbt, Bit val);
+void
+size_RoarBitTable (RoarBitTable* rbt, zuint n);
+void
+pack_RoarBitTable (RoarBitTable* rbt);
+Bit
+ck_RoarBitTable (const RoarBitTable* rbt, zuint i);
+Bit
+set1_RoarBitTable (RoarBitTable* rbt, zuint i);
+Bit
+set0_RoarBitTable (RoarBitTable* rbt, zuint i);
+zuint
+count_RoarBitTable (const RoarBitTable* rbt);
+zuint
+next_RoarBitTable (const RoarBitTable* rbt, zuint idx);
+zuint
+beg_RoarBitTable (const RoarBitTable* rbt);
+void
+op2_RoarBitTable (RoarBitTable* c, BitOp op,
+                  const RoarBitTable* a, const RoarBitTable* b);
+Bit
+fold_map2_RoarBitTable (BitOp fold_op, BitOp map_op,
+                        const RoarBitTable* a, const RoarBitTable* b);
+void
+copy_BitTable_RoarBitTable (BitTable* bt, const RoarBitTable* rbt);
+void
+copy_RoarBitTable_BitTable (RoarBitTable* rbt, const BitTable bt);
+
+qual_inline
+  RoarBitTable
+dflt1_RoarBitTable (zuint nbits)
+{
+  RoarBitTable rbt = DEFAULT_RoarBitTable;
+  rbt.sz = nbits;
+  return rbt;
+}
+
+qual_inline
+  RoarBitTable
+cons2_RoarBitTable (zuint nbits, Bit val)
+{
+  RoarBitTable rbt = dflt1_RoarBitTable (nbits);
+  if (val)
+    wipe_RoarBitTable (&rbt, val);
+  return rbt;
+}
+
+/** Set a bit.
+ * \sa set0_RoarBitTable()
+ * \sa set1_RoarBitTable()
+ **/
+qual_inline
+  Bit
+setb_RoarBitTable (RoarBitTable* rbt, zuint i, Bit b)
+{
+  return (b ? set1_RoarBitTable (rbt, i) : set0_RoarBitTable (rbt, i));
+}
+
+qual_inline
+  void
+op_RoarBitTable (RoarBitTable* a, BitOp op, const RoarBitTable* b)
+{
+  op2_RoarBitTable (a, op, a, b);
+}
+
+#endif
@@ -2,27 +2,24 @@
 #include "sesp.h"
 #include "alphatab.h"
 
-static
-  Sign
-cmp_MemLoc (const void* a, const void* b)
-{
-  if ((size_t) a < (size_t) b) {
-    return -1;
-  }
-  if ((size_t) a == (size_t) b) {
-    return 0;
-  }
-  return 1;
-}
+/** Bytes in each chunk of the arena for interned strings.**/
+#define SymChunkSz 4096
 
   SespCtx*
 make_SespCtx ()
 {
   SespCtx* ctx = AllocT( SespCtx, 1 );
-  InitAssocia( SespVT*, SespKind*, ctx->kindmap, cmp_MemLoc );
+  InitHashAssocia( SespVT*, SespKind*, ctx->kindmap, hash_MemLoc, cmp_MemLoc );
   ctx->nil.base.kind = 0;
   ctx->nil.car = 0;
   ctx->nil.cdr = 0;
+  {uint i = 0;for (; i < NKindSlots_SespCtx; ++i)
+    ctx->kind_slots[i] = 0;}
+  ctx->syms = dflt3_HashTable (offsetof( SespCCStrBase, s ),
+                               (HashFn) hash_cstr_loc,
+                               (PosetCmpFn) cmp_cstr_loc);
+  InitTable( ctx->sym_chunks );
+  ctx->sym_off = 0;
   return ctx;
 }
 
@@ -38,6 +35,10 @@ free_SespCtx (SespCtx* ctx)
     free_SespKind (kind);
   }}
   lose_Associa (&ctx->kindmap);
+  lose_HashTable (&ctx->syms);
+  {zuint i = 0;for (; i < ctx->sym_chunks.sz; ++i)
+    free (ctx->sym_chunks.s[i]);}
+  LoseTable( ctx->sym_chunks );
   free (ctx);
 }
 
@@ -49,18 +50,40 @@ ctx_of_Sesp (const Sesp a)
   return a->kind->ctx;
 }
 
+/** Slot of the kind cache for {vt}, by Fibonacci hashing of its address.**/
+static
+  uint
+kind_slot (const SespVT* vt)
+{
+  const luint h = (luint) (size_t) vt * (luint) 0x9E3779B97F4A7C15ull;
+  return (uint) (h >> (8 * sizeof(luint) - 8)) % NKindSlots_SespCtx;
+}
+
+/** Get the kind for {vt}, making it on first use.
+ * Kinds are found in {kind_slots} without touching {kindmap}
+ * unless two VTs in use share a slot.
+ **/
   SespKind*
 ensure_kind_SespCtx (SespCtx* ctx, const SespVT* vt)
 {
-  bool added = false;
-  Assoc* assoc =
-    ensure1_Associa (&ctx->kindmap, vt, &added);
-  if (added) {
-    SespKind* kind = make_SespKind (vt);
+  SespKind** slot = &ctx->kind_slots[kind_slot (vt)];
+  SespKind* kind = *slot;
+  Assoc* assoc;
+
+  if (kind && kind->vt == vt)
+    return kind;
+
+  assoc = lookup_Associa (&ctx->kindmap, &vt);
+  if (assoc) {
+    kind = *(SespKind**) val_of_Assoc (&ctx->kindmap, assoc);
+  }
+  else {
+    kind = make_SespKind (vt);
     kind->ctx = ctx;
-    val_fo_Assoc (&ctx->kindmap, assoc, &kind);
+    insert_Associa (&ctx->kindmap, &vt, &kind);
   }
-  return *(SespKind**) val_of_Assoc (&ctx->kindmap, assoc);
+  *slot = kind;
+  return kind;
 }
 
 /** Easy make function for SespKind.*/
@@ -154,14 +177,26 @@ list4_Sesp (Sesp a, Sesp b, Sesp c, Sesp d)
   return &cons->base;
 }
 
+/** Append {a} to {list}.
+ * This takes constant time once the walk reaches a vector.
+ **/
   bool
 pushlast_Sesp (Sesp list, Sesp a)
 {
-  Sesp b = cdr_of_Sesp (list);
+  Sesp b;
+  if (vec_ck_Sesp (list)) {
+    push_SespVec (to_SespVecView (list)->vec, a);
+    return true;
+  }
   if (nil_ck_Sesp (list))  return false;
   if (!list_ck_Sesp (list))  return false;
+  b = cdr_of_Sesp (list);
   while (!nil_ck_Sesp (b))
   {
+    if (vec_ck_Sesp (b)) {
+      push_SespVec (to_SespVecView (b)->vec, a);
+      return true;
+    }
     list = b;
     b = cdr_of_Sesp (list);
   }
@@ -238,6 +273,55 @@ ccstr_of_SespCCStr (const Sesp base)
   return to_SespCCStr (base) -> s;
 }
 
+/** Copy {n} bytes of {s} into the string arena.
+ * Long strings get a chunk of their own, which goes before the
+ * chunk being filled.
+ **/
+static
+  const char*
+arena_dup (SespCtx* ctx, const char* s, zuint n)
+{
+  char* dst;
+  if (n > SymChunkSz / 4)
+  {
+    TableT(cstr)* chunks = &ctx->sym_chunks;
+    dst = AllocT( char, n );
+    PushTable( *chunks, dst );
+    if (chunks->sz > 1) {
+      chunks->s[chunks->sz-1] = chunks->s[chunks->sz-2];
+      chunks->s[chunks->sz-2] = dst;
+    }
+    else {
+      ctx->sym_off = SymChunkSz;
+    }
+  }
+  else
+  {
+    if (ctx->sym_chunks.sz == 0 || ctx->sym_off + n > SymChunkSz) {
+      PushTable( ctx->sym_chunks, AllocT( char, SymChunkSz ) );
+      ctx->sym_off = 0;
+    }
+    dst = &ctx->sym_chunks.s[ctx->sym_chunks.sz-1][ctx->sym_off];
+    ctx->sym_off += n;
+  }
+  memcpy (dst, s, n);
+  return dst;
+}
+
+/** Get the unique interned atom for the text of {s}.
+ * The text is copied into an arena owned by {ctx},
+ * so interned atoms with equal text are the same pointer.
+ **/
+  SespCCStr
+intern_SespCCStr (SespCtx* ctx, const char* s)
+{
+  SespCCStr sp = (SespCCStr) find_HashTable (&ctx->syms, &s);
+  if (sp)  return sp;
+  sp = make_SespCCStr (ctx, arena_dup (ctx, s, strlen (s) + 1));
+  insert_HashTable (&ctx->syms, sp);
+  return sp;
+}
+
   const SespVT*
 vt_SespCCStr ()
 {
@@ -302,3 +386,93 @@ vt_SespInt ()
   return &vt;
 }
 
+
+/** Make a view of {vec} starting at {off}.**/
+static
+  SespVecView
+take_view (SespVec vec, zuint off)
+{
+  SespCtx* ctx = ctx_of_Sesp (vec_of_SespVec (vec));
+  SespKind* kind = ensure_kind_SespCtx (ctx, vt_SespVecView ());
+  SespVecView v = to_SespVecView (take_SespKind (kind));
+  v->vec = vec;
+  v->off = off;
+  return v;
+}
+
+/** Make an empty vector.**/
+  SespVec
+make_SespVec (SespCtx* ctx)
+{
+  SespKind* kind = ensure_kind_SespCtx (ctx, vt_SespVec ());
+  SespVec v = to_SespVec (take_SespKind (kind));
+  v->view.vec = v;
+  v->view.off = 0;
+  InitTable( v->elts );
+  InitTable( v->views );
+  PushTable( v->views, &v->view );
+  return v;
+}
+
+/** Append {a} to the vector.**/
+  void
+push_SespVec (SespVec v, Sesp a)
+{
+  PushTable( v->elts, a );
+}
+
+/** Get the view of the elements after the first,
+ * or the context's nil if there are none.
+ **/
+  Sesp
+cdr_of_SespVecView (SespVecView v)
+{
+  SespVec vec = v->vec;
+  const zuint off = v->off + 1;
+  if (off >= vec->elts.sz)
+    return &ctx_of_Sesp (&v->base)->nil.base;
+
+  while (vec->views.sz <= off)
+    PushTable( vec->views, 0 );
+  if (!vec->views.s[off])
+    vec->views.s[off] = take_view (vec, off);
+  return &vec->views.s[off]->base;
+}
+
+static void lose_SespVec (Sesp base)
+{
+  SespVec v = to_SespVec (base);
+  LoseTable( v->elts );
+  LoseTable( v->views );
+}
+
+  const SespVT*
+vt_SespVec ()
+{
+  static bool vt_initialized = false;
+  static SespVT vt;
+  if (!vt_initialized) {
+    vt_initialized = true;
+    memset (&vt, 0, sizeof (vt));
+    vt.kind_name = "Vec";
+    vt.base_offset = offsetof( SespVecBase, view.base );
+    vt.size = sizeof(SespVecBase);
+    vt.lose_fn = lose_SespVec;
+  }
+  return &vt;
+}
+
+  const SespVT*
+vt_SespVecView ()
+{
+  static bool vt_initialized = false;
+  static SespVT vt;
+  if (!vt_initialized) {
+    vt_initialized = true;
+    memset (&vt, 0, sizeof (vt));
+    vt.kind_name = "VecView";
+    vt.base_offset = offsetof( SespVecViewBase, base );
+    vt.size = sizeof(SespVecViewBase);
+  }
+  return &vt;
+}
@@ -5,6 +5,7 @@
 #ifndef Sesp_H_
 #define Sesp_H_
 #include "associa.h"
+#include "hashtable.h"
 
 typedef struct SespBase SespBase;
 typedef SespBase* Sesp;
@@ -16,11 +17,20 @@ typedef struct SespCStrBase SespCStrBase;
 typedef struct SespCCStrBase SespCCStrBase;
 typedef struct SespNatBase SespNatBase;
 typedef struct SespIntBase SespIntBase;
+typedef struct SespVecBase SespVecBase;
+typedef struct SespVecViewBase SespVecViewBase;
 typedef SespCellBase* SespCell;
 typedef SespCStrBase* SespCStr;
 typedef SespCCStrBase* SespCCStr;
 typedef SespNatBase* SespNat;
 typedef SespIntBase* SespInt;
+typedef SespVecBase* SespVec;
+typedef SespVecViewBase* SespVecView;
+
+#define DeclTableT_Sesp
+DeclTableT( Sesp, Sesp );
+#define DeclTableT_SespVecView
+DeclTableT( SespVecView, SespVecView );
 
 struct SespBase
 {
@@ -41,11 +51,26 @@ struct SespCellBase
   SespCell cdr;
 };
 
+/** Number of slots in the kind cache of a SespCtx.**/
+#define NKindSlots_SespCtx 16
+
 struct SespCtx
 {
   SespCellBase nil;
-  
+  /** Direct-mapped cache of {kindmap}, indexed by a hash of the VT address.
+   * Each slot holds the last kind found there, or NULL.
+   **/
+  SespKind* kind_slots[NKindSlots_SespCtx];
   Associa kindmap;
+  /** Interned strings, as \ref SespCCStr payloads keyed by their text.
+   * \sa intern_SespCCStr()
+   **/
+  HashTable syms;
+  /** Chunks of the arena holding interned text.
+   * The last one is being filled.
+   **/
+  TableT(cstr) sym_chunks;
+  zuint sym_off;  /**< Bytes used in the last chunk.**/
 };
 
 struct SespCCStrBase
@@ -72,6 +97,32 @@ struct SespIntBase
   int i;
 };
 
+/** List of the elements of a vector from some index onward.
+ * Views are what the cdr of a vector gives, so they hold nothing else.
+ **/
+struct SespVecViewBase
+{
+  SespBase base;
+  SespVec vec;  /**< Vector holding the elements.**/
+  zuint off;  /**< Index in {vec} of this view's first element.**/
+};
+
+/** List whose elements are stored contiguously.
+ *
+ * The vector itself is the view at offset 0. Taking its cdr gives a view
+ * of the elements after the first, and so on. Views are made on demand
+ * and kept by the vector, so walking a vector with cdr_of_Sesp() makes
+ * each view only once. Every view sees elements appended to the vector,
+ * except that the cdr of the last element is the context's nil.
+ **/
+struct SespVecBase
+{
+  SespVecViewBase view;  /**< View at offset 0.**/
+  TableT(Sesp) elts;
+  /** View for each offset made so far, or NULL.**/
+  TableT(SespVecView) views;
+};
+
 struct SespVT
 {
   const char* kind_name;
@@ -88,6 +139,8 @@ const SespVT* vt_SespCStr ();
 const SespVT* vt_SespCCStr ();
 const SespVT* vt_SespNat ();
 const SespVT* vt_SespInt ();
+const SespVT* vt_SespVec ();
+const SespVT* vt_SespVecView ();
 
 SespCtx*
 make_SespCtx ();
@@ -117,6 +170,13 @@ list4_Sesp (Sesp a, Sesp b, Sesp c, Sesp d);
 bool
 pushlast_Sesp (Sesp list, Sesp a);
 
+SespVec
+make_SespVec (SespCtx* ctx);
+void
+push_SespVec (SespVec v, Sesp a);
+Sesp
+cdr_of_SespVecView (SespVecView v);
+
 qual_inline
   void
 lose_Sesp (Sesp sp)
@@ -163,6 +223,72 @@ to_SespInt (Sesp sp)
   return CastUp( SespIntBase, base, sp );
 }
 
+/** Get the view of a vector or of one of its suffixes.**/
+qual_inline
+  SespVecView
+to_SespVecView (Sesp sp)
+{
+  return CastUp( SespVecViewBase, base, sp );
+}
+
+/** Get the vector itself, which must not be a suffix view.**/
+qual_inline
+  SespVec
+to_SespVec (Sesp sp)
+{
+  return CastUp( SespVecBase, view, to_SespVecView (sp) );
+}
+
+/** Check if this is a vector or a view of one.**/
+qual_inline
+  bool
+vec_ck_Sesp (const Sesp a)
+{
+  return (a->kind && (a->kind->vt == vt_SespVec () ||
+                      a->kind->vt == vt_SespVecView ()));
+}
+
+/** Number of elements in the view.**/
+qual_inline
+  zuint
+sz_of_SespVecView (const SespVecView v)
+{
+  return v->vec->elts.sz - v->off;
+}
+
+/** Get element {i} of the view.**/
+qual_inline
+  Sesp
+elt_of_SespVecView (const SespVecView v, zuint i)
+{
+  Claim2( i ,<, sz_of_SespVecView (v) );
+  return v->vec->elts.s[v->off + i];
+}
+
+/** Number of elements in the vector.**/
+qual_inline
+  zuint
+sz_of_SespVec (const SespVec v)
+{
+  return v->elts.sz;
+}
+
+/** Get element {i} of the vector.**/
+qual_inline
+  Sesp
+elt_of_SespVec (const SespVec v, zuint i)
+{
+  Claim2( i ,<, sz_of_SespVec (v) );
+  return v->elts.s[i];
+}
+
+qual_inline
+  Sesp
+vec_of_SespVec (SespVec v)
+{
+  return &v->view.base;
+}
+
 qual_inline
   const char*
 ccstr_of_Sesp (const Sesp a)
@@ -178,15 +304,18 @@ qual_inline
   bool
 nil_ck_Sesp (const Sesp a)
 {
-  return !a->kind;
+  if (!a->kind)  return true;
+  if (vec_ck_Sesp (a))
+    return sz_of_SespVecView (to_SespVecView (a)) == 0;
+  return false;
 }
 /** Check if this is a list.**/
 qual_inline
   bool
 list_ck_Sesp (const Sesp a)
 {
-  if (nil_ck_Sesp (a))  return true;
-  return (a->kind->vt == vt_SespCell ());
+  if (!a->kind)  return true;
+  return (a->kind->vt == vt_SespCell () || vec_ck_Sesp (a));
 }
 /** Check if this is not a list.**/
 qual_inline
@@ -214,6 +343,9 @@ car_of_Sesp (Sesp a)
   if (nil_ck_Sesp (a)) {
     return a;
   }
+  if (vec_ck_Sesp (a)) {
+    return elt_of_SespVecView (to_SespVecView (a), 0);
+  }
   if (list_ck_Sesp (a)) {
     SespCell cons = to_SespCell (a);
     return cons->car;
@@ -229,6 +361,9 @@ cdr_of_Sesp (Sesp a)
   if (nil_ck_Sesp (a)) {
     return a;
   }
+  if (vec_ck_Sesp (a)) {
+    return cdr_of_SespVecView (to_SespVecView (a));
+  }
   if (list_ck_Sesp (a)) {
     SespCell cons = to_SespCell (a);
     cons = cons->cdr;
@@ -307,6 +442,8 @@ sz_of_Sesp (Sesp a)
 {
   uint n = 0;
   while (!nil_ck_Sesp (a)) {
+    if (vec_ck_Sesp (a))
+      return n + sz_of_SespVecView (to_SespVecView (a));
     a = cdr_of_Sesp (a);
     n += 1;
   }
@@ -326,6 +463,11 @@ car_fo_Sesp (Sesp a, Sesp b)
     DBog0( "Called on an atom!" );
     return false;
   }
+  if (vec_ck_Sesp (a)) {
+    SespVecView v = to_SespVecView (a);
+    v->vec->elts.s[v->off] = b;
+    return true;
+  }
   a_cell = to_SespCell (a);
   a_cell->car = b;
   return true;
@@ -348,6 +490,10 @@ cdr_fo_Sesp (Sesp a, Sesp b)
     DBog0( "Can't replace cdr with non-list!" );
     return false;
   }
+  if (vec_ck_Sesp (a)) {
+    DBog0( "Can't replace cdr of a vector!" );
+    return false;
+  }
   a_cell->cdr = to_SespCell (b);
   return true;
 }
@@ -360,6 +506,8 @@ SespNat
 make_SespNat (SespCtx* ctx, uint u);
 SespInt
 make_SespInt (SespCtx* ctx, int i);
+SespCCStr
+intern_SespCCStr (SespCtx* ctx, const char* s);
 
 qual_inline
   Sesp
@@ -375,6 +523,13 @@ make_ccstr_Sesp (SespCtx* ctx, const char* s)
   return &make_SespCCStr (ctx, s)->base;
 }
 
+qual_inline
+  Sesp
+intern_ccstr_Sesp (SespCtx* ctx, const char* s)
+{
+  return &intern_SespCCStr (ctx, s)->base;
+}
+
 qual_inline
   Sesp
 make_Nat_Sesp (SespCtx* ctx, uint u)
@@ -0,0 +1,177 @@
+/**
+ * \file shardassocia.c
+ * Hash map which many threads can write at once.
+ **/
+#include "shardassocia.h"
+#include "thirdparty/hash-ThomasWang.c"
+
+/** Create a sharded map.
+ * It takes ownership of {map}, which must be an empty hash table map,
+ * such as one from InitHashAssocia(). The other shards copy its layout.
+ * \param nshards  Rounded up to a power of 2.
+ **/
+  ShardAssocia*
+make_ShardAssocia (Associa* map, uint nshards)
+{
+  ShardAssocia* sa = AllocT( ShardAssocia, 1 );
+  uint n;
+  Claim2( map->kind ,==, Associa_Hash );
+  Claim( !beg_Associa (map) );
+
+  sa->lgshards = 0;
+  while (((uint) 1 << sa->lgshards) < nshards)
+    ++ sa->lgshards;
+  n = (uint) 1 << sa->lgshards;
+  sa->hash = map->ht->hash;
+  sa->shards = AllocT( AssociaShard, n );
+
+  {uint i = 0;for (; i < n; ++i) {
+    init_SpinLock (&sa->shards[i].lock);
+    sa->shards[i].map = (i == 0) ? *map : like_Associa (map);
+  }}
+  return sa;
+}
+
+/** Free everything.
+ * No other threads may be using the map.
+ **/
+  void
+free_ShardAssocia (ShardAssocia* sa)
+{
+  {uint i = 0;for (; i < ((uint) 1 << sa->lgshards); ++i)
+    lose_Associa (&sa->shards[i].map);}
+  free (sa->shards);
+  free (sa);
+}
+
+/** Index of the shard which holds {key}.**/
+  uint
+shard_of_ShardAssocia (const ShardAssocia* sa, const void* key)
+{
+  if (sa->lgshards == 0)  return 0;
+  return uint32_hash_ThomasWang (sa->hash (key)) >> (32 - sa->lgshards);
+}
+
+/** Lock the shard which holds {key} and get its map.
+ * Only keys of the same shard may be used with the map.
+ * \sa unlock_ShardAssocia()
+ **/
+  Associa*
+lock_ShardAssocia (ShardAssocia* sa, const void* key)
+{
+  AssociaShard* shard = &sa->shards[shard_of_ShardAssocia (sa, key)];
+  lock_SpinLock (&shard->lock);
+  return &shard->map;
+}
+
+  void
+unlock_ShardAssocia (ShardAssocia* sa, const void* key)
+{
+  unlock_SpinLock (&sa->shards[shard_of_ShardAssocia (sa, key)].lock);
+}
+
+/** Find the value for {key}.
+ * \param val  Where to copy the value. Can be NULL.
+ * \return  Whether {key} was found.
+ **/
+  bool
+lookup_ShardAssocia (ShardAssocia* sa, const void* key, void* val)
+{
+  AssociaShard* shard = &sa->shards[shard_of_ShardAssocia (sa, key)];
+  Assoc* a;
+  lock_SpinLock (&shard->lock);
+  a = lookup_Associa (&shard->map, key);
+  if (a && val)
+    memcpy (val, val_of_Assoc (&shard->map, a), shard->map.val_sz);
+  unlock_SpinLock (&shard->lock);
+  return !!a;
+}
+
+/** Associate {key} with {val} unless {key} already has a value.
+ * \param val  Can be NULL for a set.
+ * \return  Whether {key} was added.
+ **/
+  bool
+ensure_ShardAssocia (ShardAssocia* sa, const void* key, const void* val)
+{
+  AssociaShard* shard = &sa->shards[shard_of_ShardAssocia (sa, key)];
+  bool added = false;
+  Assoc* a;
+  lock_SpinLock (&shard->lock);
+  a = ensure1_Associa (&shard->map, key, &added);
+  if (added && val)
+    val_fo_Assoc (&shard->map, a, val);
+  unlock_SpinLock (&shard->lock);
+  return added;
+}
+
+/** Associate {key} with {val}, replacing any old value.**/
+  void
+put_ShardAssocia (ShardAssocia* sa, const void* key, const void* val)
+{
+  AssociaShard* shard = &sa->shards[shard_of_ShardAssocia (sa, key)];
+  bool added = false;
+  Assoc* a;
+  lock_SpinLock (&shard->lock);
+  a = ensure1_Associa (&shard->map, key, &added);
+  val_fo_Assoc (&shard->map, a, val);
+  unlock_SpinLock (&shard->lock);
+}
+
+/** Remove the association for {key}.
+ * \return  Whether {key} was found.
+ **/
+  bool
+remove_ShardAssocia (ShardAssocia* sa, const void* key)
+{
+  AssociaShard* shard = &sa->shards[shard_of_ShardAssocia (sa, key)];
+  Assoc* a;
+  lock_SpinLock (&shard->lock);
+  a = lookup_Associa (&shard->map, key);
+  if (a)
+    give_Associa (&shard->map, a);
+  unlock_SpinLock (&shard->lock);
+  return !!a;
+}
+
+/** Number of associations.
+ * This is only a snapshot when other threads are writing.
+ **/
+  zuint
+sz_of_ShardAssocia (ShardAssocia* sa)
+{
+  zuint n = 0;
+  {uint i = 0;for (; i < ((uint) 1 << sa->lgshards); ++i) {
+    AssociaShard* shard = &sa->shards[i];
+    lock_SpinLock (&shard->lock);
+    n += shard->map.ht->sz;
+    unlock_SpinLock (&shard->lock);
+  }}
+  return n;
+}
+
+/** Call {f} on every association, with shards visited in parallel
+ * when OpenMP is enabled. Each shard is locked while it is visited,
+ * so {f} must not use this map, and it must be safe to call from
+ * several threads at once.
+ **/
+  void
+par_walk_ShardAssocia (ShardAssocia* sa,
+                       void (* f) (Associa*, Assoc*, void*), void* dat)
+{
+  const long n = (long) 1 << sa->lgshards;
+  long i;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (i = 0; i < n; ++i)
+  {
+    AssociaShard* shard = &sa->shards[i];
+    Assoc* a;
+    lock_SpinLock (&shard->lock);
+    for (a = beg_Associa (&shard->map); a; a = next_Assoc (a))
+      f (&shard->map, a, dat);
+    unlock_SpinLock (&shard->lock);
+  }
+}
+
@@ -0,0 +1,64 @@
+/**
+ * \file shardassocia.h
+ * Hash map which many threads can write at once.
+ *
+ * Keys are split among a power-of-2 number of shards by a rehash of their
+ * hash (with Thomas Wang's hash), so a key's shard is independent of the
+ * bits its shard's hash table uses. Each shard is a hash table \ref Associa
+ * with its own association pool and spin lock, so threads only contend
+ * when they touch the same shard.
+ *
+ * Keys and values are copied in and out, since an association can be
+ * removed by another thread as soon as its shard is unlocked.
+ * For compound operations, use lock_ShardAssocia() to work on a shard
+ * directly.
+ **/
+#ifndef ShardAssocia_H_
+#define ShardAssocia_H_
+#include "associa.h"
+#include "spinlock.h"
+
+typedef struct AssociaShard AssociaShard;
+typedef struct ShardAssocia ShardAssocia;
+
+struct AssociaShard
+{
+  SpinLock lock;
+  Associa map;
+  /** Keep neighboring locks off of this shard's cache lines.**/
+  byte pad[64];
+};
+
+struct ShardAssocia
+{
+  AssociaShard* shards;
+  uint lgshards;
+  HashFn hash;
+};
+
+ShardAssocia*
+make_ShardAssocia (Associa* map, uint nshards);
+void
+free_ShardAssocia (ShardAssocia* sa);
+uint
+shard_of_ShardAssocia (const ShardAssocia* sa, const void* key);
+Associa*
+lock_ShardAssocia (ShardAssocia* sa, const void* key);
+void
+unlock_ShardAssocia (ShardAssocia* sa, const void* key);
+bool
+lookup_ShardAssocia (ShardAssocia* sa, const void* key, void* val);
+bool
+ensure_ShardAssocia (ShardAssocia* sa, const void* key, const void* val);
+void
+put_ShardAssocia (ShardAssocia* sa, const void* key, const void* val);
+bool
+remove_ShardAssocia (ShardAssocia* sa, const void* key);
+zuint
+sz_of_ShardAssocia (ShardAssocia* sa);
+void
+par_walk_ShardAssocia (ShardAssocia* sa,
+                       void (* f) (Associa*, Assoc*, void*), void* dat);
+
+#endif
+
@@ -0,0 +1,284 @@
+/**
+ * \file snapassocia.c
+ * Associative array for many readers and few writers.
+ **/
+#include "snapassocia.h"
+
+static
+  SnapVersion*
+make_version (Associa map)
+{
+  SnapVersion* v = AllocT( SnapVersion, 1 );
+  v->map = map;
+  v->sz = 0;
+  v->epoch = 0;
+  v->next = 0;
+  return v;
+}
+
+static
+  void
+free_version (SnapVersion* v)
+{
+  lose_Associa (&v->map);
+  free (v);
+}
+
+/** Free retired snapshots which no reader can be using.**/
+static
+  void
+reclaim (SnapAssocia* sa)
+{
+  luint min_epoch = AtomicLoad( &sa->epoch );
+  SnapVersion** p = &sa->retired;
+
+  {uint i = 0;for (; i < NReaders_SnapAssocia; ++i) {
+    const luint e = AtomicLoad( &sa->readers[i].epoch );
+    if (e != 0 && e < min_epoch)
+      min_epoch = e;
+  }}
+
+  while (*p)
+  {
+    SnapVersion* v = *p;
+    if (v->epoch < min_epoch)
+    {
+      *p = v->next;
+      free_version (v);
+    }
+    else
+    {
+      p = &v->next;
+    }
+  }
+}
+
+/** Create a snapshot map.
+ * It takes ownership of {map}, which becomes the first snapshot.
+ * Later snapshots use the same layout and search structure.
+ **/
+  SnapAssocia*
+make_SnapAssocia (Associa* map)
+{
+  SnapAssocia* sa = AllocT( SnapAssocia, 1 );
+  Assoc* a;
+
+  {uint i = 0;for (; i < NReaders_SnapAssocia; ++i) {
+    sa->readers[i].epoch = 0;
+    sa->readers[i].used = 0;
+  }}
+  sa->cur = make_version (*map);
+  for (a = beg_Associa (map); a; a = next_Assoc (a))
+    ++ sa->cur->sz;
+  sa->epoch = 1;
+
+  init_SpinLock (&sa->publish_lock);
+  sa->retired = 0;
+  init_SpinLock (&sa->lock);
+  sa->adds = like_Associa (map);
+  sa->dels = like_Associa (map);
+  sa->nadds = 0;
+  return sa;
+}
+
+/** Free everything.
+ * No readers or writers may be active.
+ **/
+  void
+free_SnapAssocia (SnapAssocia* sa)
+{
+  while (sa->retired)
+  {
+    SnapVersion* v = sa->retired;
+    sa->retired = v->next;
+    free_version (v);
+  }
+  free_version (sa->cur);
+  lose_Associa (&sa->adds);
+  lose_Associa (&sa->dels);
+  free (sa);
+}
+
+/** Claim a reader slot.
+ * Each reading thread should claim one and keep it
+ * until release_reader_SnapAssocia().
+ * \return  The slot, or UINT_MAX if all of them are taken.
+ **/
+  uint
+reader_SnapAssocia (SnapAssocia* sa)
+{
+  {uint i = 0;for (; i < NReaders_SnapAssocia; ++i) {
+    if (!AtomicLoad( &sa->readers[i].used ) &&
+        !AtomicExchange( &sa->readers[i].used, 1 ))
+      return i;
+  }}
+  return UINT_MAX;
+}
+
+/** Give back a reader slot, which must not be reading.**/
+  void
+release_reader_SnapAssocia (SnapAssocia* sa, uint reader)
+{
+  Claim2( reader ,<, NReaders_SnapAssocia );
+  Claim2( sa->readers[reader].epoch ,==, 0 );
+  AtomicStore( &sa->readers[reader].used, 0 );
+}
+
+/** Start reading.
+ * \return  The current snapshot, which must not be modified.
+ *   It stays valid until leave_SnapAssocia().
+ **/
+  Associa*
+enter_SnapAssocia (SnapAssocia* sa, uint reader)
+{
+  AtomicStore( &sa->readers[reader].epoch, AtomicLoad( &sa->epoch ) );
+  return &((SnapVersion*) AtomicLoad( &sa->cur ))->map;
+}
+
+/** Stop reading.**/
+  void
+leave_SnapAssocia (SnapAssocia* sa, uint reader)
+{
+  AtomicStore( &sa->readers[reader].epoch, 0 );
+}
+
+/** Stage an association of {key} with {val}, replacing any old value.
+ * Readers will not see it until publish_SnapAssocia().
+ **/
+  void
+stage_insert_SnapAssocia (SnapAssocia* sa, const void* key, const void* val)
+{
+  bool added = false;
+  Assoc* a;
+  lock_SpinLock (&sa->lock);
+  if (lookup_Associa (&sa->dels, key))
+    remove_Associa (&sa->dels, key);
+  a = ensure1_Associa (&sa->adds, key, &added);
+  if (val)
+    val_fo_Assoc (&sa->adds, a, val);
+  if (added)
+    ++ sa->nadds;
+  unlock_SpinLock (&sa->lock);
+}
+
+/** Stage the removal of {key}.
+ * Readers will not see it until publish_SnapAssocia().
+ **/
+  void
+stage_remove_SnapAssocia (SnapAssocia* sa, const void* key)
+{
+  lock_SpinLock (&sa->lock);
+  if (lookup_Associa (&sa->adds, key))
+  {
+    remove_Associa (&sa->adds, key);
+    -- sa->nadds;
+  }
+  ensure_Associa (&sa->dels, key);
+  unlock_SpinLock (&sa->lock);
+}
+
+/** Append the key and value of {a} to the arrays.**/
+static
+  void
+push_assoc (Associa* map, Assoc* a, byte* keys, byte* vals, zuint* n)
+{
+  memcpy (&keys[*n * map->key_sz], key_of_Assoc (map, a), map->key_sz);
+  memcpy (&vals[*n * map->val_sz], val_of_Assoc (map, a), map->val_sz);
+  ++ *n;
+}
+
+/** Build the contents of the next snapshot from {old} and the staged
+ * changes. For ordered maps, this is a merge, so the result is sorted.
+ **/
+static
+  zuint
+merge_staged (Associa* old, Associa* adds, Associa* dels,
+              byte* keys, byte* vals)
+{
+  const bool ordered = (old->kind != Associa_Hash);
+  Assoc* a = beg_Associa (old);
+  Assoc* b = beg_Associa (adds);
+  zuint n = 0;
+
+  while (a || b)
+  {
+    Sign si;
+    if (!a)
+      si = 1;
+    else if (!b)
+      si = -1;
+    else if (ordered)
+      si = cmp_keys_Associa (old, key_of_Assoc (old, a),
+                             key_of_Assoc (adds, b));
+    else
+      si = lookup_Associa (adds, key_of_Assoc (old, a)) ? 0 : -1;
+
+    if (si < 0)
+    {
+      if (!lookup_Associa (dels, key_of_Assoc (old, a)))
+        push_assoc (old, a, keys, vals, &n);
+      a = next_Assoc (a);
+    }
+    else if (si == 0 && !ordered)
+    {
+      /* Replaced by a staged association, which comes later.*/
+      a = next_Assoc (a);
+    }
+    else
+    {
+      push_assoc (adds, b, keys, vals, &n);
+      b = next_Assoc (b);
+      if (si == 0)
+        a = next_Assoc (a);
+    }
+  }
+  return n;
+}
+
+/** Publish all staged changes as a new snapshot.
+ * This takes time linear in the size of the map,
+ * but staging is only blocked while the staged changes are taken.
+ **/
+  void
+publish_SnapAssocia (SnapAssocia* sa)
+{
+  SnapVersion* old;
+  SnapVersion* v;
+  Associa adds;
+  Associa dels;
+  zuint nadds;
+  byte* keys;
+  byte* vals;
+
+  lock_SpinLock (&sa->publish_lock);
+  old = sa->cur;
+
+  /* Take the staged changes, leaving empty maps for later ones.*/
+  lock_SpinLock (&sa->lock);
+  adds = sa->adds;
+  dels = sa->dels;
+  nadds = sa->nadds;
+  sa->adds = like_Associa (&adds);
+  sa->dels = like_Associa (&dels);
+  sa->nadds = 0;
+  unlock_SpinLock (&sa->lock);
+
+  keys = AllocT( byte, (old->sz + nadds) * old->map.key_sz + 1 );
+  vals = AllocT( byte, (old->sz + nadds) * old->map.val_sz + 1 );
+
+  v = make_version (like_Associa (&old->map));
+  v->sz = merge_staged (&old->map, &adds, &dels, keys, vals);
+  bulkload_Associa (&v->map, keys, vals, v->sz, true);
+  free (keys);
+  free (vals);
+  lose_Associa (&adds);
+  lose_Associa (&dels);
+
+  /* Readers entering after the epoch advances will see {v}.*/
+  AtomicStore( &sa->cur, v );
+  old->epoch = AtomicFetchAdd( &sa->epoch, 1 );
+  old->next = sa->retired;
+  sa->retired = old;
+  reclaim (sa);
+  unlock_SpinLock (&sa->publish_lock);
+}
@@ -0,0 +1,99 @@
+/**
+ * \file snapassocia.h
+ * Associative array for many readers and few writers.
+ *
+ * Readers look up and iterate over an immutable snapshot (an \ref Associa)
+ * without taking any lock. Writers stage insertions and removals,
+ * then publish them all at once as a new snapshot.
+ * Old snapshots are freed once no reader can still be using them,
+ * which is tracked by epochs:
+ *
+ * - Each reader owns a slot, which it releases when it is done for good.
+ *   Upon entering, it writes the current epoch to its slot.
+ *   Upon leaving, it clears the slot.
+ * - Publishing swaps in the new snapshot, then advances the epoch.
+ *   The old snapshot is stamped with the epoch it was retired in.
+ * - A retired snapshot is freed once every occupied slot holds a later
+ *   epoch, since those readers must have seen a newer snapshot.
+ *
+ * Publishing copies the whole map, so writes should be batched.
+ * The copy is built without holding the lock that staging takes,
+ * so only other publishers wait for it.
+ **/
+#ifndef SnapAssocia_H_
+#define SnapAssocia_H_
+#include "associa.h"
+#include "spinlock.h"
+
+typedef struct SnapVersion SnapVersion;
+typedef struct SnapReader SnapReader;
+typedef struct SnapAssocia SnapAssocia;
+
+/** Maximum number of reader slots.**/
+#define NReaders_SnapAssocia 64
+
+/** An immutable snapshot.**/
+struct SnapVersion
+{
+  Associa map;
+  zuint sz;
+  luint epoch;  /**< When it was retired.**/
+  SnapVersion* next;  /**< Next in the list of retired snapshots.**/
+};
+
+/** Reader slot, padded so that readers do not share cache lines.**/
+struct SnapReader
+{
+  luint epoch;  /**< Zero when the reader is not reading.**/
+  Bit used;  /**< Whether a reader owns the slot.**/
+  byte pad[64 - sizeof(luint) - sizeof(Bit)];
+};
+
+struct SnapAssocia
+{
+  SnapReader readers[NReaders_SnapAssocia];
+  SnapVersion* cur;
+  luint epoch;
+
+  /** Held by publishers, even while they build the next snapshot.
+   * Publishers are the only writers of {cur} and {retired}.
+   **/
+  SpinLock publish_lock;
+  SnapVersion* retired;
+
+  /** Held by writers while staging, and by publishers just long enough
+   * to take what was staged.
+   * Everything below is only touched while holding it.
+   **/
+  SpinLock lock;
+  /** Staged insertions, in a map of the same kind as the snapshots.
+   * So they are ordered by key unless the snapshots are hash tables,
+   * whose {cmp_fn} may only tell equality.
+   **/
+  Associa adds;
+  /** Staged removals, kept like {adds}.**/
+  Associa dels;
+  zuint nadds;
+};
+
+SnapAssocia*
+make_SnapAssocia (Associa* map);
+void
+free_SnapAssocia (SnapAssocia* sa);
+uint
+reader_SnapAssocia (SnapAssocia* sa);
+void
+release_reader_SnapAssocia (SnapAssocia* sa, uint reader);
+Associa*
+enter_SnapAssocia (SnapAssocia* sa, uint reader);
+void
+leave_SnapAssocia (SnapAssocia* sa, uint reader);
+void
+stage_insert_SnapAssocia (SnapAssocia* sa, const void* key, const void* val);
+void
+stage_remove_SnapAssocia (SnapAssocia* sa, const void* key);
+void
+publish_SnapAssocia (SnapAssocia* sa);
+
+#endif
+
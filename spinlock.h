@@ -0,0 +1,74 @@
+/**
+ * \file spinlock.h
+ * Spin lock and the atomic operations behind it.
+ *
+ * These rely on GCC-style atomic builtins.
+ * Without them, everything still works, but only within one thread.
+ **/
+#ifndef SpinLock_H_
+#define SpinLock_H_
+#include "def.h"
+
+typedef struct SpinLock SpinLock;
+
+struct SpinLock
+{
+  Bit held;
+};
+
+#define DEFAULT_SpinLock  { 0 }
+
+#ifdef __GNUC__
+#define AtomicLoad( p )  __atomic_load_n (p, __ATOMIC_SEQ_CST)
+#define AtomicStore( p, x )  __atomic_store_n (p, x, __ATOMIC_SEQ_CST)
+#define AtomicFetchAdd( p, x )  __atomic_fetch_add (p, x, __ATOMIC_SEQ_CST)
+#define AtomicExchange( p, x )  __atomic_exchange_n (p, x, __ATOMIC_SEQ_CST)
+#if defined(__i386__) || defined(__x86_64__)
+#define CpuRelax()  __builtin_ia32_pause ()
+#else
+#define CpuRelax()  do {} while (0)
+#endif
+#else
+#define AtomicLoad( p )  (*(p))
+#define AtomicStore( p, x )  (*(p) = (x))
+#define AtomicFetchAdd( p, x )  ((*(p) += (x)) - (x))
+#define AtomicExchange( p, x )  exchange_SpinLock (p, x)
+#define CpuRelax()  do {} while (0)
+qual_inline
+  Bit
+exchange_SpinLock (Bit* p, Bit x)
+{
+  const Bit y = *p;
+  *p = x;
+  return y;
+}
+#endif
+
+qual_inline
+  void
+init_SpinLock (SpinLock* lock)
+{
+  lock->held = 0;
+}
+
+qual_inline
+  void
+lock_SpinLock (SpinLock* lock)
+{
+  while (AtomicExchange( &lock->held, 1 ))
+  {
+    /* Wait without writing so the cache line is not bounced around.*/
+    while (AtomicLoad( &lock->held ))
+      CpuRelax();
+  }
+}
+
+qual_inline
+  void
+unlock_SpinLock (SpinLock* lock)
+{
+  AtomicStore( &lock->held, 0 );
+}
+
+#endif
+
@@ -2,6 +2,7 @@
  * \file sxpn.c
  **/
 #include "sxpn.h"
+#include "associa.h"
 
   void
 oput_ConsAtom (OFile* of, const ConsAtom* ca)
@@ -48,3 +49,942 @@ oput_Cons (OFile* of, const Cons* a)
   oput_char_OFile (of, ')');
 }
 
+
+static
+  uint32_t
+hash_ConsAtom (const ConsAtom* ca)
+{
+  switch (ca->kind)
+  {
+  case Cons_Cons:
+    return hash_MemLoc ((const void* const*) &ca->as.cons);
+  case Cons_MemLoc:
+    return hash_MemLoc ((const void* const*) &ca->as.memloc);
+  case Cons_AlphaTab:
+    return hash_AlphaTab (&ca->as.alphatab);
+  case Cons_cstr:
+    return hash_bytes (ca->as.cstr, strlen (ca->as.cstr));
+  case Cons_int:
+    return hash_bytes (&ca->as.i, sizeof(ca->as.i));
+  case Cons_uint:
+    return hash_uint (&ca->as.ui);
+  case Cons_ujint:
+    return hash_bytes (&ca->as.uji, sizeof(ca->as.uji));
+  case Cons_real:
+    return hash_bytes (&ca->as.re, sizeof(ca->as.re));
+  default:
+    break;
+  }
+  return 0;
+}
+
+/** Hash a cell by its atom and the address of its cdr.
+ * Since shared cells are unique, the addresses of shared cars and cdrs
+ * stand in for their structure.
+ **/
+  uint32_t
+hash_Cons (const Cons* a)
+{
+  uint32_t h = hash_MemLoc ((const void* const*) &a->cdr);
+  h ^= hash_ConsAtom (&a->car) + 0x9e3779b9 + (h << 6) + (h >> 2);
+  return h + (uint32_t) a->car.kind;
+}
+
+/** Check whether two cells are equal in the way hash_Cons() expects.
+ * Only the equality result is meaningful.
+ **/
+  Sign
+cmp_Cons (const Cons* a, const Cons* b)
+{
+  const ConsAtom* x = &a->car;
+  const ConsAtom* y = &b->car;
+  Bit eq = 0;
+  if (a->cdr != b->cdr || x->kind != y->kind)
+    return 1;
+
+  switch (x->kind)
+  {
+  case Cons_Cons:
+    eq = (x->as.cons == y->as.cons);
+    break;
+  case Cons_MemLoc:
+    eq = (x->as.memloc == y->as.memloc);
+    break;
+  case Cons_AlphaTab:
+    eq = (0 == cmp_AlphaTab (&x->as.alphatab, &y->as.alphatab));
+    break;
+  case Cons_cstr:
+    eq = (0 == strcmp (x->as.cstr, y->as.cstr));
+    break;
+  case Cons_int:
+    eq = (x->as.i == y->as.i);
+    break;
+  case Cons_uint:
+    eq = (x->as.ui == y->as.ui);
+    break;
+  case Cons_ujint:
+    eq = (x->as.uji == y->as.uji);
+    break;
+  case Cons_real:
+    eq = (0 == memcmp (&x->as.re, &y->as.re, sizeof(x->as.re)));
+    break;
+  default:
+    eq = 1;
+    break;
+  }
+  return eq ? 0 : 1;
+}
+
+/** Turn on hash-consing for cells made by intern2_Sxpn().**/
+  void
+intern_fo_Sxpn (Sxpn* sx)
+{
+  if (sx->interns)  return;
+  sx->interns = AllocT( HashTable, 1 );
+  *sx->interns = dflt3_HashTable (0, (HashFn) hash_Cons,
+                                  (PosetCmpFn) cmp_Cons);
+}
+
+/** Like take2_Sxpn(), but give the shared cell equal to ({a} . {b})
+ * when hash-consing is on.
+ * Either way, the caller's reference held by {a} is consumed,
+ * and the returned cell has a reference for the caller.
+ **/
+  Cons*
+intern2_Sxpn (Sxpn* sx, ConsAtom a, Cons* b)
+{
+  Cons key;
+  Cons* c;
+  if (!sx->interns)
+    return take2_Sxpn (sx, a, b);
+
+  key.car = a;
+  key.cdr = b;
+  c = (Cons*) find_HashTable (sx->interns, &key);
+  if (c)
+  {
+    inc_Cons (c);
+    lose_ConsAtom (&a, sx);
+    return c;
+  }
+  c = take2_Sxpn (sx, a, b);
+  c->interned = true;
+  insert_HashTable (sx->interns, c);
+  return c;
+}
+
+/** Release a cell {a} which has no more references,
+ * along with whatever it alone holds.
+ *
+ * This uses no stack or heap beyond the cells themselves.
+ * The cdr chain is followed in a loop. A dead cell whose car is a cell
+ * goes onto a list, linked through its cdr (which is already followed),
+ * and its car is released later.
+ **/
+static
+  void
+release_Sxpn (Sxpn* sx, Cons* a)
+{
+  Cons* pending = 0;
+  while (1)
+  {
+    while (a)
+    {
+      Cons* b = a;
+      a = a->cdr;
+      if (b->car.kind == Cons_Cons && b->car.as.cons)
+      {
+        b->cdr = pending;
+        pending = b;
+      }
+      else
+      {
+        lose_ConsAtom (&b->car, sx);
+        give_LgTable (&sx->cells, b);
+      }
+
+      /* Continue along the cdr if it has no other references.*/
+      if (a)
+      {
+        dec_Cons (a);
+        if (a->nrefs > 0)  a = 0;
+        else if (a->interned)  remove_HashTable (sx->interns, a);
+      }
+    }
+
+    if (!pending)  break;
+    a = pending->car.as.cons;
+    {
+      Cons* b = pending;
+      pending = b->cdr;
+      give_LgTable (&sx->cells, b);
+    }
+    dec_Cons (a);
+    if (a->nrefs > 0)  a = 0;
+    else if (a->interned)  remove_HashTable (sx->interns, a);
+  }
+}
+
+/** Give back a reference to {a}.
+ * When that was the last reference, {a} and whatever it alone holds
+ * are released, or deferred until flush_Sxpn() if deferring.
+ **/
+  void
+give_Sxpn (Sxpn* sx, Cons* a)
+{
+  if (!a)  return;
+  dec_Cons (a);
+  if (a->nrefs > 0)  return;
+  /* Unshare right away so the cell cannot be found again.*/
+  if (a->interned)
+    remove_HashTable (sx->interns, a);
+  if (sx->defer)
+    PushTable( sx->later, a );
+  else
+    release_Sxpn (sx, a);
+}
+
+/** Release all cells whose release was deferred.**/
+  void
+flush_Sxpn (Sxpn* sx)
+{
+  zuint i;
+  for (i = 0; i < sx->later.sz; ++i)
+    release_Sxpn (sx, (Cons*) sx->later.s[i]);
+  ClearTable( sx->later );
+}
+
+/** Start or stop deferring the release of cells.
+ * While deferring, give_Sxpn() takes constant time,
+ * and flush_Sxpn() releases everything in one pass later.
+ * Stopping flushes.
+ **/
+  void
+defer_Sxpn (Sxpn* sx, bool defer)
+{
+  sx->defer = defer;
+  if (!defer)
+    flush_Sxpn (sx);
+}
+
+
+/* Binary format.
+ *
+ * All integers are LEB128 varints unless noted.
+ *
+ *   "SXB1"
+ *   number of strings, then each as its length and bytes (no NUL)
+ *   number of cells, then each cell record
+ *   number of roots, then each as its cell index plus one (0 for NULL)
+ *
+ * A cell record is a tag of (kind << 1 | has_cdr), then the atom,
+ * then the cdr's cell index if it has one. Atoms are encoded as:
+ *   Cons_Cons: cell index plus one (0 for NULL)
+ *   Cons_AlphaTab, Cons_cstr: string index
+ *   Cons_int: zigzag varint
+ *   Cons_uint, Cons_ujint: varint
+ *   Cons_real: IEEE 754 bits of the \ref real in 8 bytes, low byte first
+ *   others: nothing (Cons_MemLoc loads as NULL)
+ *
+ * Cells are written children first, so every cell index in a record
+ * refers to an earlier record.
+ */
+
+static const char SxpnMagic[4] = { 'S', 'X', 'B', '1' };
+
+static
+  void
+push_varint (TableT(byte)* buf, luint x)
+{
+  do
+  {
+    byte b = (byte) (x & 0x7F);
+    x >>= 7;
+    if (x != 0)  b |= 0x80;
+    PushTable( *buf, b );
+  } while (x != 0);
+}
+
+static
+  bool
+get_varint (const byte* data, zuint sz, zuint* off, luint* ret)
+{
+  luint x = 0;
+  uint shift = 0;
+  while (*off < sz && shift < 64)
+  {
+    const byte b = data[(*off)++];
+    x |= (luint) (b & 0x7F) << shift;
+    if ((b & 0x80) == 0)
+    {
+      *ret = x;
+      return true;
+    }
+    shift += 7;
+  }
+  return false;
+}
+
+/** Index of a string in the table, adding it if necessary.**/
+static
+  zuint
+str_idx (Associa* strs, TableT(byte)* head, zuint* nstrs, const AlphaTab* t)
+{
+  bool added = false;
+  Assoc* a = ensure1_Associa (strs, t, &added);
+  if (added)
+  {
+    zuint n = t->sz;
+    if (n > 0 && !t->s[n-1])  --n;
+    push_varint (head, n);
+    GrowTable( *head, n );
+    memcpy (&head->s[head->sz - n], t->s, n);
+    val_fo_Assoc (strs, a, nstrs);
+    ++ *nstrs;
+  }
+  return *(zuint*) val_of_Assoc (strs, a);
+}
+
+/** Write one cell record, taking its children's indices from {vals}.**/
+static
+  void
+oput_record (TableT(byte)* body, TableT(zuint)* vals,
+             Associa* strs, TableT(byte)* head, zuint* nstrs,
+             const Cons* c)
+{
+  const ConsAtom* ca = &c->car;
+  zuint cdr_idx = 0;
+  zuint car_ref = 0;
+
+  if (c->cdr)
+    cdr_idx = vals->s[-- vals->sz];
+  if (ca->kind == Cons_Cons && ca->as.cons)
+    car_ref = 1 + vals->s[-- vals->sz];
+
+  push_varint (body, ((luint) ca->kind << 1) | (c->cdr ? 1 : 0));
+  switch (ca->kind)
+  {
+  case Cons_Cons:
+    push_varint (body, car_ref);
+    break;
+  case Cons_AlphaTab:
+    push_varint (body, str_idx (strs, head, nstrs, &ca->as.alphatab));
+    break;
+  case Cons_cstr:
+    {
+      const AlphaTab t = dflt1_AlphaTab (ca->as.cstr);
+      push_varint (body, str_idx (strs, head, nstrs, &t));
+    }
+    break;
+  case Cons_int:
+    push_varint (body, ca->as.i < 0
+                 ? 2 * (luint) (-(ca->as.i + 1)) + 1
+                 : 2 * (luint) ca->as.i);
+    break;
+  case Cons_uint:
+    push_varint (body, ca->as.ui);
+    break;
+  case Cons_ujint:
+    push_varint (body, ca->as.uji);
+    break;
+  case Cons_real:
+    {
+      uint64_t bits = 0;
+      if (sizeof(ca->as.re) == sizeof(bits)) {
+        memcpy (&bits, &ca->as.re, sizeof(bits));
+      }
+      else {
+        uint32_t b32;
+        memcpy (&b32, &ca->as.re, sizeof(b32));
+        bits = b32;
+      }
+      {uint i = 0;for (; i < 8; ++i)
+        PushTable( *body, (byte) (bits >> (8 * i)) );}
+    }
+    break;
+  default:
+    break;
+  }
+  if (c->cdr)
+    push_varint (body, cdr_idx);
+}
+
+/** Write trees in a compact binary format.
+ *
+ * Each cell is written once. A cell with more than one reference is
+ * remembered, so later references to it become back-references.
+ * Equal strings are written once.
+ * This uses no recursion, so deep trees are fine.
+ *
+ * \sa open_SxpnLoader()
+ **/
+  void
+oput_bin_Sxpn (OFile* of, Cons* const* roots, zuint nroots)
+{
+  DeclTable( byte, head );
+  DeclTable( byte, body );
+  DeclTable( MemLoc, stk );
+  DeclTable( zuint, vals );
+  DeclTable( byte, tail );
+  Associa strs;
+  Associa shared;
+  zuint nstrs = 0;
+  zuint ncells = 0;
+
+  InitHashAssocia( AlphaTab, zuint, strs, hash_AlphaTab, cmp_AlphaTab );
+  InitHashAssocia( const Cons*, zuint, shared, hash_MemLoc, cmp_MemLoc );
+
+  push_varint (&tail, nroots);
+  {zuint r = 0;for (; r < nroots; ++r) {
+    if (!roots[r])
+    {
+      push_varint (&tail, 0);
+      continue;
+    }
+    PushTable( stk, (void*) roots[r] );
+    while (stk.sz > 0)
+    {
+      /* The low bit marks cells whose children are done.*/
+      const uintptr_t top = (uintptr_t) stk.s[-- stk.sz];
+      const Cons* c = (const Cons*) (top & ~(uintptr_t) 1);
+      Assoc* a = lookup_Associa (&shared, &c);
+
+      if (a)
+      {
+        PushTable( vals, *(zuint*) val_of_Assoc (&shared, a) );
+      }
+      else if ((top & 1) == 0)
+      {
+        PushTable( stk, (void*) (top | 1) );
+        if (c->cdr)
+          PushTable( stk, (void*) c->cdr );
+        if (c->car.kind == Cons_Cons && c->car.as.cons)
+          PushTable( stk, (void*) c->car.as.cons );
+      }
+      else
+      {
+        oput_record (&body, &vals, &strs, &head, &nstrs, c);
+        if (c->nrefs != 1)
+        {
+          a = ensure_Associa (&shared, &c);
+          val_fo_Assoc (&shared, a, &ncells);
+        }
+        PushTable( vals, ncells );
+        ++ ncells;
+      }
+    }
+    Claim2( vals.sz ,==, 1 );
+    push_varint (&tail, 1 + vals.s[-- vals.sz]);
+  }}
+
+  {
+    DeclTable( byte, counts );
+    oputn_char_OFile (of, SxpnMagic, sizeof(SxpnMagic));
+    push_varint (&counts, nstrs);
+    oputn_char_OFile (of, (char*) counts.s, counts.sz);
+    oputn_char_OFile (of, (char*) head.s, head.sz);
+    ClearTable( counts );
+    push_varint (&counts, ncells);
+    oputn_char_OFile (of, (char*) counts.s, counts.sz);
+    oputn_char_OFile (of, (char*) body.s, body.sz);
+    oputn_char_OFile (of, (char*) tail.s, tail.sz);
+    LoseTable( counts );
+  }
+
+  LoseTable( head );
+  LoseTable( body );
+  LoseTable( tail );
+  LoseTable( stk );
+  LoseTable( vals );
+  lose_Associa (&strs);
+  lose_Associa (&shared);
+}
+
+/** Read the parts of a cell record.
+ * \return  Offset just past the record, or 0 if it is malformed.
+ **/
+static
+  zuint
+parse_record (const SxpnLoader* ld, zuint off, zuint idx,
+              ConsKind* kind, luint* atom, zuint* cdr_ref)
+{
+  luint tag;
+  luint x;
+  *atom = 0;
+  *cdr_ref = 0;
+  if (!get_varint (ld->data, ld->sz, &off, &tag))  return 0;
+  if ((tag >> 1) >= Cons_NKinds)  return 0;
+  *kind = (ConsKind) (tag >> 1);
+
+  switch (*kind)
+  {
+  case Cons_Cons:
+    if (!get_varint (ld->data, ld->sz, &off, atom))  return 0;
+    if (*atom > idx)  return 0;
+    break;
+  case Cons_AlphaTab:
+  case Cons_cstr:
+    if (!get_varint (ld->data, ld->sz, &off, atom))  return 0;
+    if (*atom >= ld->str_offs.sz)  return 0;
+    break;
+  case Cons_int:
+  case Cons_uint:
+  case Cons_ujint:
+    if (!get_varint (ld->data, ld->sz, &off, atom))  return 0;
+    break;
+  case Cons_real:
+    if (ld->sz - off < 8)  return 0;
+    {uint i = 0;for (; i < 8; ++i)
+      *atom |= (luint) ld->data[off + i] << (8 * i);}
+    off += 8;
+    break;
+  default:
+    break;
+  }
+
+  if (tag & 1)
+  {
+    if (!get_varint (ld->data, ld->sz, &off, &x))  return 0;
+    if (x >= idx)  return 0;
+    *cdr_ref = 1 + (zuint) x;
+  }
+  return off;
+}
+
+/** Index the binary format written by oput_bin_Sxpn().
+ * Every record is parsed and checked here, before this returns.
+ * {data} must hold all of it and stay valid while the loader is used.
+ * Cells are made in {sx}, so they are shared if it does hash-consing.
+ * \return  false if the data is malformed.
+ **/
+  bool
+open_SxpnLoader (SxpnLoader* ld, Sxpn* sx, const byte* data, zuint sz)
+{
+  zuint off = sizeof(SxpnMagic);
+  luint n;
+
+  ld->sx = sx;
+  ld->data = data;
+  ld->sz = sz;
+  InitTable( ld->str_offs );
+  InitTable( ld->cell_offs );
+  InitTable( ld->roots );
+  InitTable( ld->cells );
+
+  if (sz < off || 0 != memcmp (data, SxpnMagic, off))
+    return false;
+
+  if (!get_varint (data, sz, &off, &n))  return false;
+  while (n-- > 0)
+  {
+    luint len;
+    PushTable( ld->str_offs, off );
+    if (!get_varint (data, sz, &off, &len))  return false;
+    if (len > sz - off)  return false;
+    off += len;
+  }
+
+  if (!get_varint (data, sz, &off, &n))  return false;
+  while (n-- > 0)
+  {
+    ConsKind kind;
+    luint atom;
+    zuint cdr_ref;
+    PushTable( ld->cell_offs, off );
+    off = parse_record (ld, off, ld->cell_offs.sz - 1, &kind, &atom, &cdr_ref);
+    if (off == 0)  return false;
+  }
+
+  if (!get_varint (data, sz, &off, &n))  return false;
+  while (n-- > 0)
+  {
+    luint ref;
+    if (!get_varint (data, sz, &off, &ref))  return false;
+    if (ref > ld->cell_offs.sz)  return false;
+    PushTable( ld->roots, ref );
+  }
+
+  SizeTable( ld->cells, ld->cell_offs.sz );
+  {zuint i = 0;for (; i < ld->cells.sz; ++i)
+    ld->cells.s[i] = 0;}
+  return true;
+}
+
+/** Read all the rest of {xf} into its buffer, then index it.
+ * {xf} must stay valid while the loader is used.
+ * \sa open_SxpnLoader()
+ **/
+  bool
+xget_SxpnLoader (SxpnLoader* ld, Sxpn* sx, XFile* xf)
+{
+  xget_XFile (xf);
+  return open_SxpnLoader (ld, sx, &xf->buf.s[xf->off], xf->buf.sz - xf->off);
+}
+
+/** Give back the loader's references.
+ * Cells taken from root_SxpnLoader() stay valid.
+ **/
+  void
+lose_SxpnLoader (SxpnLoader* ld)
+{
+  {zuint i = 0;for (; i < ld->cells.sz; ++i)
+    give_Sxpn (ld->sx, (Cons*) ld->cells.s[i]);}
+  LoseTable( ld->str_offs );
+  LoseTable( ld->cell_offs );
+  LoseTable( ld->roots );
+  LoseTable( ld->cells );
+}
+
+/** Make a string atom from string {i} of the table.**/
+static
+  ConsAtom
+str_atom (const SxpnLoader* ld, ConsKind kind, zuint i)
+{
+  ConsAtom ca = dflt_ConsAtom ();
+  zuint off = ld->str_offs.s[i];
+  luint len = 0;
+  const char* s;
+  get_varint (ld->data, ld->sz, &off, &len);
+  s = (const char*) &ld->data[off];
+
+  ca.kind = kind;
+  if (kind == Cons_AlphaTab)
+  {
+    ca.as.alphatab = dflt_AlphaTab ();
+    cat1_cstr_AlphaTab (&ca.as.alphatab, s, len);
+  }
+  else
+  {
+    ca.as.cstr = AllocT( char, len+1 );
+    memcpy (ca.as.cstr, s, len);
+    ca.as.cstr[len] = 0;
+  }
+  return ca;
+}
+
+/** Get root {i}, making the cells it needs if they have not been made.
+ * \return  A new reference, to be given back with give_Sxpn().
+ **/
+  Cons*
+root_SxpnLoader (SxpnLoader* ld, zuint i)
+{
+  DeclTable( zuint, stk );
+  zuint ref;
+  Claim2( i ,<, ld->roots.sz );
+  ref = ld->roots.s[i];
+  if (ref == 0)  return 0;
+
+  PushTable( stk, ref - 1 );
+  while (stk.sz > 0)
+  {
+    const zuint j = stk.s[stk.sz-1];
+    ConsKind kind;
+    luint atom;
+    zuint cdr_ref;
+    bool ready = true;
+    ConsAtom ca;
+    Cons* cdr;
+
+    if (ld->cells.s[j])
+    {
+      -- stk.sz;
+      continue;
+    }
+
+    parse_record (ld, ld->cell_offs.s[j], j, &kind, &atom, &cdr_ref);
+    if (kind == Cons_Cons && atom > 0 && !ld->cells.s[atom-1])
+    {
+      PushTable( stk, (zuint) atom - 1 );
+      ready = false;
+    }
+    if (cdr_ref > 0 && !ld->cells.s[cdr_ref-1])
+    {
+      PushTable( stk, cdr_ref - 1 );
+      ready = false;
+    }
+    if (!ready)  continue;
+
+    ca = dflt_ConsAtom ();
+    ca.kind = kind;
+    switch (kind)
+    {
+    case Cons_Cons:
+      ca = dflt_Cons_ConsAtom (atom > 0 ? (Cons*) ld->cells.s[atom-1] : 0);
+      break;
+    case Cons_AlphaTab:
+    case Cons_cstr:
+      ca = str_atom (ld, kind, (zuint) atom);
+      break;
+    case Cons_int:
+      ca.as.i = (int) ((atom & 1) ? -(long) (atom >> 1) - 1 : (long) (atom >> 1));
+      break;
+    case Cons_uint:
+      ca.as.ui = (uint) atom;
+      break;
+    case Cons_ujint:
+      ca.as.uji = (ujint) atom;
+      break;
+    case Cons_real:
+      {
+        const uint64_t bits = atom;
+        const uint32_t b32 = (uint32_t) atom;
+        if (sizeof(ca.as.re) == sizeof(bits))
+          memcpy (&ca.as.re, &bits, sizeof(bits));
+        else
+          memcpy (&ca.as.re, &b32, sizeof(b32));
+      }
+      break;
+    default:
+      break;
+    }
+
+    cdr = (cdr_ref > 0) ? (Cons*) ld->cells.s[cdr_ref-1] : 0;
+    ld->cells.s[j] = intern2_Sxpn (ld->sx, ca, cdr);
+    -- stk.sz;
+  }
+  LoseTable( stk );
+
+  inc_Cons ((Cons*) ld->cells.s[ref-1]);
+  return (Cons*) ld->cells.s[ref-1];
+}
+
+/** Characters which end an unquoted atom.**/
+static const char SxpnDelims[] = " \t\v\r\n();\"";
+
+  void
+init_SxpnParser (SxpnParser* p, Sxpn* sx, XFile* xf)
+{
+  p->sx = sx;
+  p->xf = xf;
+  InitTable( p->atoms );
+  InitTable( p->opens );
+  p->bad = false;
+}
+
+/** Give back the elements of lists which are still open.**/
+static
+  void
+drop_open_lists (SxpnParser* p)
+{
+  {zuint i = 0;for (; i < p->atoms.sz; ++i)
+    lose_ConsAtom (&p->atoms.s[i], p->sx);}
+  ClearTable( p->atoms );
+  ClearTable( p->opens );
+}
+
+  void
+lose_SxpnParser (SxpnParser* p)
+{
+  drop_open_lists (p);
+  LoseTable( p->atoms );
+  LoseTable( p->opens );
+}
+
+/** Skip whitespace and comments.
+ * \return  The next character, or -1 at the end of input.
+ **/
+static
+  int
+skip_space (XFile* xf)
+{
+  for (;;)
+  {
+    char c;
+    skipds_XFile (xf, WhiteSpaceChars);
+    if (xf->off + 1 >= xf->buf.sz)
+      return -1;
+    c = (char) xf->buf.s[xf->off];
+    if (c == ';')
+      skiplined_XFile (xf, "\n");
+    else if (c == '\0')
+      xf->off += 1;
+    else
+      return c;
+  }
+}
+
+/** Read the rest of a quoted string, whose opening quote was read.
+ * A backslash escapes the next character, and \n and \t mean
+ * newline and tab.
+ **/
+static
+  bool
+xget_quoted (XFile* xf, AlphaTab* t)
+{
+  char c;
+  while (xget_char_XFile (xf, &c))
+  {
+    if (c == '"')
+      return true;
+    if (c == '\\')
+    {
+      if (!xget_char_XFile (xf, &c))  break;
+      if (c == 'n')  c = '\n';
+      else if (c == 't')  c = '\t';
+    }
+    cat_char_AlphaTab (t, c);
+  }
+  return false;
+}
+
+/** Make an atom from the NUL-terminated token {s} of length {n}.**/
+static
+  ConsAtom
+token_ConsAtom (const char* s, zuint n)
+{
+  ConsAtom ca = dflt_ConsAtom ();
+  const char* end = &s[n];
+  const char c = (s[0] == '-' || s[0] == '+') ? s[1] : s[0];
+
+  if (('0' <= c && c <= '9') || c == '.')
+  {
+    if (xget_int_cstr (&ca.as.i, s) == end)
+    {
+      ca.kind = Cons_int;
+      return ca;
+    }
+    if (s[0] != '-' && xget_ujint_cstr (&ca.as.uji, s) == end)
+    {
+      ca.kind = Cons_ujint;
+      return ca;
+    }
+    if (xget_real_cstr (&ca.as.re, s) == end)
+    {
+      ca.kind = Cons_real;
+      return ca;
+    }
+  }
+  ca = dflt_ConsAtom ();
+  ca.kind = Cons_AlphaTab;
+  ca.as.alphatab = dflt_AlphaTab ();
+  cat1_cstr_AlphaTab (&ca.as.alphatab, s, n);
+  return ca;
+}
+
+/** Read an unquoted atom.**/
+static
+  ConsAtom
+xget_token (XFile* xf)
+{
+  char* s = tods_XFile (xf, SxpnDelims);
+  char* beg = cstr_of_XFile (xf);
+  const zuint n = IdxElt( beg, s );
+  const char c = s[0];
+  ConsAtom ca;
+
+  s[0] = '\0';
+  ca = token_ConsAtom (beg, n);
+  s[0] = c;
+  xf->off += n;
+  return ca;
+}
+
+/** Make a list from the elements of the innermost open list.
+ * \return  A new reference to the list, or NULL if it is empty.
+ **/
+static
+  Cons*
+close_list (SxpnParser* p)
+{
+  const zuint beg = p->opens.s[-- p->opens.sz];
+  Cons* cdr = 0;
+  while (p->atoms.sz > beg)
+  {
+    Cons* c = intern2_Sxpn (p->sx, p->atoms.s[-- p->atoms.sz], cdr);
+    give_Sxpn (p->sx, cdr);
+    cdr = c;
+  }
+  return cdr;
+}
+
+/** Read the next top-level form.
+ * Since every form is a list, the form is NULL for "()".
+ * \param ret  Where to put a new reference to the form,
+ *   to be given back with give_Sxpn().
+ * \return  false at the end of input or when the text is malformed,
+ *   in which case {bad} is set.
+ **/
+  bool
+xget_SxpnParser (SxpnParser* p, Cons** ret)
+{
+  XFile* xf = p->xf;
+  *ret = 0;
+  if (p->bad)  return false;
+
+  for (;;)
+  {
+    const int c = skip_space (xf);
+    ConsAtom ca;
+
+    if (c < 0)
+    {
+      if (p->opens.sz == 0)  return false;
+      break;
+    }
+    if (c == '(')
+    {
+      xf->off += 1;
+      PushTable( p->opens, p->atoms.sz );
+      continue;
+    }
+    if (p->opens.sz == 0)
+      break;
+
+    if (c == ')')
+    {
+      Cons* list;
+      xf->off += 1;
+      list = close_list (p);
+      if (p->opens.sz == 0)
+      {
+        *ret = list;
+        return true;
+      }
+      ca = dflt_ConsAtom ();
+      ca.kind = Cons_Cons;
+      ca.as.cons = list;
+    }
+    else if (c == '"')
+    {
+      xf->off += 1;
+      ca = dflt_ConsAtom ();
+      ca.kind = Cons_AlphaTab;
+      ca.as.alphatab = dflt_AlphaTab ();
+      if (!xget_quoted (xf, &ca.as.alphatab))
+      {
+        lose_AlphaTab (&ca.as.alphatab);
+        break;
+      }
+    }
+    else
+    {
+      ca = xget_token (xf);
+    }
+    PushTable( p->atoms, ca );
+  }
+
+  p->bad = true;
+  drop_open_lists (p);
+  return false;
+}
+
+/** Read every top-level form of {xf} and call {fn} on each.
+ * {fn} owns a reference to the form, which it should give back
+ * with give_Sxpn(). It can return false to stop reading.
+ * \return  false if the text is malformed.
+ **/
+  bool
+xget_each_Sxpn (Sxpn* sx, XFile* xf, bool (*fn) (Cons*, void*), void* dat)
+{
+  SxpnParser p[1];
+  Cons* form;
+  bool good;
+  init_SxpnParser (p, sx, xf);
+  while (xget_SxpnParser (p, &form))
+  {
+    if (!fn (form, dat))  break;
+  }
+  good = !p->bad;
+  lose_SxpnParser (p);
+  return good;
+}
@@ -5,10 +5,13 @@
 #define Sxpn_H_
 #include "lgtable.h"
 #include "fileb.h"
+#include "hashtable.h"
 
 typedef struct ConsAtom ConsAtom;
 typedef struct Cons Cons;
 typedef struct Sxpn Sxpn;
+typedef struct SxpnLoader SxpnLoader;
+typedef struct SxpnParser SxpnParser;
 
 enum ConsKind {
     Cons_Cons, /* car is a Cons */
@@ -42,23 +45,120 @@ struct ConsAtom
     } as;
 };
 
+#define DeclTableT_ConsAtom
+DeclTableT( ConsAtom, ConsAtom );
+
 struct Cons
 {
     Cons* cdr;
     ConsAtom car;
     uint nrefs;
+    /** Whether this cell is shared through the intern table.**/
+    bool interned;
 };
 
+/** Pool of cells.
+ *
+ * When hash-consing is on (see intern_fo_Sxpn()), cells made by
+ * intern2_Sxpn() are shared. Structurally equal cells made that way are
+ * the same cell, so comparing them is a pointer comparison.
+ * Shared cells must not be modified.
+ **/
 struct Sxpn
 {
   LgTable cells;
+  /** Table of shared cells, or NULL when hash-consing is off.**/
+  HashTable* interns;
+  /** Whether give_Sxpn() defers releasing cells.
+   * \sa defer_Sxpn()
+   **/
+  bool defer;
+  /** Cells which lost their last reference while deferring.**/
+  TableT(MemLoc) later;
 };
-#define DEFAULT_Sxpn { DEFAULT1_LgTable(Cons) }
+#define DEFAULT_Sxpn { DEFAULT1_LgTable(Cons), 0, false, DEFAULT_Table }
 
 void
 oput_ConsAtom (OFile* of, const ConsAtom* ca);
 void
 oput_Cons (OFile* of, const Cons* a);
+uint32_t
+hash_Cons (const Cons* a);
+Sign
+cmp_Cons (const Cons* a, const Cons* b);
+void
+intern_fo_Sxpn (Sxpn* sx);
+Cons*
+intern2_Sxpn (Sxpn* sx, ConsAtom a, Cons* b);
+void
+give_Sxpn (Sxpn* sx, Cons* a);
+void
+flush_Sxpn (Sxpn* sx);
+void
+defer_Sxpn (Sxpn* sx, bool defer);
+
+/** Reader of the binary format written by oput_bin_Sxpn().
+ *
+ * Loading is eager: opening parses and checks every record,
+ * in time and space linear in the data, and keeps an offset for each.
+ * Only the cells are made later, when a root that reaches them is
+ * requested. Each record is only ever made into one cell,
+ * so shared structure stays shared.
+ **/
+struct SxpnLoader
+{
+  Sxpn* sx;
+  const byte* data;
+  zuint sz;
+  TableT(zuint) str_offs;  /**< Offset of each string's length.**/
+  TableT(zuint) cell_offs;  /**< Offset of each cell record.**/
+  TableT(zuint) roots;  /**< Cell index plus one for each root, or 0.**/
+  /** Cell made from each record so far, each holding a reference.**/
+  TableT(MemLoc) cells;
+};
+
+void
+oput_bin_Sxpn (OFile* of, Cons* const* roots, zuint nroots);
+bool
+open_SxpnLoader (SxpnLoader* ld, Sxpn* sx, const byte* data, zuint sz);
+bool
+xget_SxpnLoader (SxpnLoader* ld, Sxpn* sx, XFile* xf);
+void
+lose_SxpnLoader (SxpnLoader* ld);
+Cons*
+root_SxpnLoader (SxpnLoader* ld, zuint i);
+
+/** Incremental reader of S-expression text, as written by oput_Cons().
+ *
+ * Atoms are separated by whitespace, parentheses, or double quotes.
+ * An atom becomes an int if it fits, then a ujint, then a real.
+ * Anything else, or text in double quotes, becomes an AlphaTab.
+ * A semicolon starts a comment which runs to the end of the line.
+ *
+ * Only the forms still being read are kept in memory, and the XFile
+ * may flush what was read, so a long stream of forms can be processed
+ * one at a time.
+ **/
+struct SxpnParser
+{
+  Sxpn* sx;
+  XFile* xf;
+  /** Elements of the lists which are still open.**/
+  TableT(ConsAtom) atoms;
+  /** Index in {atoms} where each open list starts.**/
+  TableT(zuint) opens;
+  /** Whether the text was malformed.**/
+  bool bad;
+};
+
+void
+init_SxpnParser (SxpnParser* p, Sxpn* sx, XFile* xf);
+void
+lose_SxpnParser (SxpnParser* p);
+bool
+xget_SxpnParser (SxpnParser* p, Cons** ret);
+bool
+xget_each_Sxpn (Sxpn* sx, XFile* xf, bool (*fn) (Cons*, void*), void* dat);
 
 
 qual_inline
@@ -107,6 +207,7 @@ dflt2_Cons (ConsAtom a, Cons* b)
   Cons c[1];
   c->car = a;
   c->nrefs = 1;
+  c->interned = false;
   c->cdr = b;
   inc_Cons (b);
   return *c;
@@ -155,8 +256,6 @@ take2_Sxpn (Sxpn* sx, ConsAtom a, Cons* b)
 }
 
 
-static void give_Sxpn (Sxpn* sx, Cons* a);
-
 qual_inline
     void
 lose_ConsAtom (ConsAtom* ca, Sxpn* sx)
@@ -177,23 +276,6 @@ lose_ConsAtom (ConsAtom* ca, Sxpn* sx)
     }
 }
 
-    void
-give_Sxpn (Sxpn* sx, Cons* a)
-{
-    while (a)
-    {
-        Cons* b;
-        dec_Cons (a);
-        if (a->nrefs > 0)  break;
-
-        lose_ConsAtom (&a->car, sx);
-
-        b = a;
-        a = a->cdr;
-        give_LgTable (&sx->cells, b);
-    }
-}
-
 qual_inline
     Cons*
 pop_Sxpn (Sxpn* sx, Cons* a)
@@ -217,6 +299,12 @@ lose_Sxpn (Sxpn* sx)
             lose_ConsAtom (&a->car, 0);
     }
     lose_LgTable (&sx->cells);
+    LoseTable( sx->later );
+    if (sx->interns)
+    {
+        lose_HashTable (sx->interns);
+        free (sx->interns);
+    }
 }
 
 
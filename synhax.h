@@ -173,6 +173,14 @@ do { \
   b = SwapT_tmp; \
 } while (0)
 
+/** Hint that the memory at {p} will be read soon.
+ * A NULL pointer is fine.
+ **/
+#ifdef __GNUC__
+#define Prefetch( p )  __builtin_prefetch (p)
+#else
+#define Prefetch( p )  ((void) (p))
+#endif
 
 /** Explicitly convert true to 1 and false to 0.**/
 #define OneIf( expr )  (!(expr) ? 0 : 1)
@@ -2,12 +2,26 @@
  * \file syscx.c
  * Interact with the operating system.
  **/
+#ifdef __linux__
+/* For splice() and syscall().*/
+#define _GNU_SOURCE
+#endif
 #include "syscx.h"
 
 #include "fileb.h"
 
 #include <errno.h>
 #include <signal.h>
+#ifdef POSIX_SOURCE
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+extern char** environ;
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
 
 DeclTableT( HookFn, struct { void (*f) (); void* x; } );
 
@@ -371,6 +385,93 @@ read_sysCx (fd_t fd, void* buf, long sz)
 #endif
 }
 
+  long
+write_sysCx (fd_t fd, const void* buf, long sz)
+{
+#ifdef POSIX_SOURCE
+  return write (fd, buf, sz);
+#else
+  return _write (fd, buf, sz);
+#endif
+}
+
+#ifdef POSIX_SOURCE
+/** Wait until {fd} can be written.
+ * Without {block}, fail with EAGAIN rather than wait.
+ **/
+static
+  bool
+await_writable (fd_t fd, bool block)
+{
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  while (true)
+  {
+    int ret = poll (&pfd, 1, block ? -1 : 0);
+    if (ret > 0)
+      return true;
+    if (ret == 0)
+    {
+      errno = EAGAIN;
+      return false;
+    }
+    if (errno != EINTR)
+      return false;
+  }
+}
+#endif
+
+/** Move up to {sz} bytes from {xfd} to {ofd}.
+ * On Linux, splice() or sendfile() moves them without copying them
+ * through this process. That works whenever one side is a pipe or the
+ * input is a regular file. Otherwise the bytes are read and written.
+ * Bytes which were read cannot be given back, so that path only reads
+ * once {ofd} can be written, and then waits on {ofd} as needed to write
+ * all of them, even if {ofd} does not block.
+ * \return  Number of bytes moved, 0 at end of input, or -1 on error.
+ **/
+  long
+splice_sysCx (fd_t xfd, fd_t ofd, long sz)
+{
+  byte buf[BUFSIZ];
+  long n;
+  long off = 0;
+#ifdef __linux__
+  n = splice (xfd, NULL, ofd, NULL, sz, SPLICE_F_MOVE);
+  if (n >= 0 || (errno != EINVAL && errno != ENOSYS))
+    return n;
+  n = sendfile (ofd, xfd, NULL, sz);
+  if (n >= 0 || (errno != EINVAL && errno != ENOSYS))
+    return n;
+#endif
+
+  if (sz > (long) sizeof(buf))
+    sz = sizeof(buf);
+#ifdef POSIX_SOURCE
+  if (!await_writable (ofd, false))
+    return -1;
+#endif
+  n = read_sysCx (xfd, buf, sz);
+  while (off < n)
+  {
+    long ret = write_sysCx (ofd, &buf[off], n - off);
+    if (ret > 0)
+      off += ret;
+#ifdef POSIX_SOURCE
+    else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      if (!await_writable (ofd, true))
+        return -1;
+    }
+#endif
+    else if (ret < 0 && errno != EINTR)
+      return -1;
+  }
+  return n;
+}
+
     bool
 closefd_sysCx (fd_t fd)
 {
@@ -408,14 +509,123 @@ oput_execvp_args (const char* fn, char* const* argv)
   flush_OFile (of);
 }
 
+#ifdef POSIX_SOURCE
+/** Add a file action for a trampoline option which takes a descriptor.**/
+static
+  bool
+fd_action_sysCx (posix_spawn_file_actions_t* acts,
+                 const char* opt, const char* arg)
+{
+  fd_t fd = parse_fd_arg_sysCx (arg);
+  if (fd < 0)  return false;
+  if (eql_cstr (opt, "-stdxfd"))
+    return 0 == posix_spawn_file_actions_adddup2 (acts, fd, 0);
+  if (eql_cstr (opt, "-stdofd"))
+    return 0 == posix_spawn_file_actions_adddup2 (acts, fd, 1);
+  return 0 == posix_spawn_file_actions_addclose (acts, fd);
+}
+
+/** Spawn without forking this process.
+ *
+ * When {argv} goes through the trampoline, its options are done here
+ * as file actions, in the order that parse_args_sysCx() would do them
+ * after a fork, and the command after "--" is spawned directly.
+ *
+ * \return  false if nothing was spawned and fork() should be used,
+ *   either because an option needs the trampoline or because
+ *   posix_spawnp() failed.
+ **/
+static
+  bool
+posix_spawnvp_sysCx (char* const* argv, pid_t* pid)
+{
+  posix_spawn_file_actions_t acts;
+  posix_spawnattr_t attr;
+  sigset_t sigs;
+  DeclTable( cstr, t );
+  bool good = true;
+
+  if (0 != posix_spawn_file_actions_init (&acts))
+    return false;
+  if (0 != posix_spawnattr_init (&attr))
+  {
+    posix_spawn_file_actions_destroy (&acts);
+    return false;
+  }
+  /* An OSPcLoop ignores SIGPIPE, but the child should not.*/
+  sigemptyset (&sigs);
+  sigaddset (&sigs, SIGPIPE);
+  good = (0 == posix_spawnattr_setsigdefault (&attr, &sigs) &&
+          0 == posix_spawnattr_setflags (&attr, POSIX_SPAWN_SETSIGDEF));
+
+  if (argv[0] && argv[1] &&
+      eql_cstr (argv[0], exename_of_sysCx ()) &&
+      eql_cstr (argv[1], MagicArgv1_sysCx))
+  {
+    char* exe = argv[0];
+    uint i = 2;
+    while (good && argv[i] && !eql_cstr (argv[i], "--"))
+    {
+      const char* arg = argv[i++];
+      if (eql_cstr (arg, "-stdxfd") ||
+          eql_cstr (arg, "-stdofd") ||
+          eql_cstr (arg, "-closefd"))
+      {
+        good = !!argv[i] && fd_action_sysCx (&acts, arg, argv[i]);
+        if (argv[i])  ++ i;
+      }
+      else if (eql_cstr (arg, "-exe"))
+      {
+        good = !!argv[i];
+        if (good)  exe = argv[i++];
+      }
+      else if (!eql_cstr (arg, "-exec"))
+      {
+        good = false;
+      }
+    }
+    good = good && !!argv[i];
+    if (good)
+    {
+      PushTable( t, exe );
+      for (++i; argv[i]; ++i)
+        PushTable( t, argv[i] );
+    }
+  }
+  else
+  {
+    uint i = 0;
+    for (; argv[i]; ++i)
+      PushTable( t, argv[i] );
+  }
+  PushTable( t, 0 );
+
+  if (good)
+    good = (0 == posix_spawnp (pid, t.s[0], &acts, &attr, t.s, environ));
+
+  posix_spawnattr_destroy (&attr);
+  posix_spawn_file_actions_destroy (&acts);
+  LoseTable( t );
+  return good;
+}
+#endif
+
+/** Spawn a process to run {argv}.
+ *
+ * On POSIX systems, posix_spawnp() is used when possible,
+ * so the cost does not grow with the size of this process.
+ **/
     pid_t
 spawnvp_sysCx (char* const* argv)
 {
     pid_t pid;
 #ifdef POSIX_SOURCE
+    if (posix_spawnvp_sysCx (argv, &pid))
+        return pid;
     pid = fork ();
     if (pid == 0)
     {
+        signal (SIGPIPE, SIG_DFL);
         if (eql_cstr (argv[0], exename_of_sysCx ()) &&
             eql_cstr (argv[1], MagicArgv1_sysCx))
         {
@@ -643,48 +853,133 @@ chdir_sysCx (const char* pathname)
     return (ret == 0);
 }
 
+#ifdef _MSC_VER
+#define ThreadLocal_sysCx __declspec(thread)
+#else
+#define ThreadLocal_sysCx __thread
+#endif
+
+/** Random bytes kept for small requests, one buffer per thread.**/
+static ThreadLocal_sysCx byte RandomBuf_sysCx[4096];
+static ThreadLocal_sysCx uint RandomOff_sysCx = sizeof(RandomBuf_sysCx);
+
+#ifdef POSIX_SOURCE
+/** Drop the buffered bytes in a child made by fork(),
+ * so that it does not hand out the same bytes as its parent.
+ * Only the forking thread lives on in the child, so its buffer is the
+ * only one to drop.
+ **/
+static
+  void
+forget_random_sysCx ()
+{
+  RandomOff_sysCx = sizeof(RandomBuf_sysCx);
+}
+
+static
+  void
+hook_fork_random_sysCx ()
+{
+  pthread_atfork (0, 0, forget_random_sysCx);
+}
+#endif
+
+static
+  bool
+urandom_fill_sysCx (byte* p, zuint size)
+{
+#ifdef POSIX_SOURCE
+  fd_t fd = open ("/dev/urandom", O_RDONLY);
+  if (fd < 0)  return false;
+  while (size > 0)
+  {
+    long n = read_sysCx (fd, p, (long) size);
+    if (n > 0)
+    {
+      p = &p[n];
+      size -= n;
+    }
+    else if (n == 0 || errno != EINTR)
+    {
+      break;
+    }
+  }
+  closefd_sysCx (fd);
+  return (size == 0);
+#else
+  (void) p;
+  (void) size;
+  return false;
+#endif
+}
+
+/** Fill {p} with {size} bytes straight from the system.**/
+static
+  bool
+fill_random_sysCx (byte* p, zuint size)
+{
+#if defined(__linux__) && defined(SYS_getrandom)
+  while (size > 0)
+  {
+    long n = syscall (SYS_getrandom, p, size, 0);
+    if (n > 0)
+    {
+      p = &p[n];
+      size -= n;
+    }
+    else if (n == 0 || errno != EINTR)
+    {
+      break;
+    }
+  }
+  if (size == 0)  return true;
+#endif
+  return urandom_fill_sysCx (p, size);
+}
+
+/** Fill {p} with {size} random bytes from the system.
+ *
+ * Small requests are served from a buffer which each thread refills
+ * with getrandom() (or /dev/urandom where that is missing).
+ * Requests as big as the buffer are filled directly.
+ * A child made by fork() drops what its parent buffered.
+ **/
   Bool
 randomize_sysCx(void* p, uint size)
 {
 #ifdef POSIX_SOURCE
-  static byte buf[4096];
-  static const uint buf_size = sizeof(buf);
-  static uint static_off = sizeof(buf);
-  uint off = static_off;  
-  ssize_t nbytes;
-
-  if (size == 0)  return 1;
-  if (size + off <= buf_size) {
-    memcpy(p, CastOff(void, buf ,+, off), size);
-    off += size;
-    static_off = off;
+  static pthread_once_t fork_hooked = PTHREAD_ONCE_INIT;
+#endif
+  byte* const buf = RandomBuf_sysCx;
+  const uint buf_size = sizeof(RandomBuf_sysCx);
+  uint off = RandomOff_sysCx;
+
+  if (size <= buf_size - off) {
+    memcpy(p, &buf[off], size);
+    RandomOff_sysCx = off + size;
     return 1;
   }
-  if (off < buf_size) {
-    size -= buf_size - off;
-    memcpy(CastOff(void, p ,+, size),
-           CastOff(void, buf ,+, off),
-           buf_size - off);
+  if (size >= buf_size) {
+    if (!fill_random_sysCx ((byte*) p, size))
+      BailOut(0, "Failed to get random bytes");
+    return 1;
   }
-  off = 0;
-
-  {
-    fd_t urandom_fd = open("/dev/urandom", O_RDONLY);
-    if (urandom_fd < 0)
-      BailOut(0, "Failed to open /dev/urandom");
 
-    nbytes = read(urandom_fd, buf, buf_size);
-    nbytes += read(urandom_fd, p, size);
-    close(urandom_fd);
+#ifdef POSIX_SOURCE
+  /* Buffering starts here, so make sure that forking drops the buffer.*/
+  pthread_once (&fork_hooked, hook_fork_random_sysCx);
+#endif
+  /* Use up the buffer, then refill it for the rest.*/
+  memcpy(p, &buf[off], buf_size - off);
+  p = CastOff(void, p ,+, buf_size - off);
+  size -= buf_size - off;
+
+  if (!fill_random_sysCx (buf, buf_size)) {
+    RandomOff_sysCx = buf_size;
+    BailOut(0, "Failed to get random bytes");
   }
-
-  if (nbytes != (int)(buf_size+size))
-    BailOut(0, "Failed to read from /dev/urandom");
-
-  static_off = off;
+  memcpy(p, buf, size);
+  RandomOff_sysCx = size;
   return 1;
-#else
-  BailOut(0, "Not available in Windows yet");
-#endif
 }
 
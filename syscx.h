@@ -66,6 +66,10 @@ bool
 dup2_sysCx (fd_t oldfd, fd_t newfd);
 long
 read_sysCx (fd_t fd, void* buf, long sz);
+long
+write_sysCx (fd_t fd, const void* buf, long sz);
+long
+splice_sysCx (fd_t xfd, fd_t ofd, long sz);
 bool
 closefd_sysCx (fd_t fd);
 FILE*
@@ -0,0 +1,48 @@
+/** David Blackman and Sebastiano Vigna's xoshiro256++ generator.
+ * From: https://prng.di.unimi.it/xoshiro256plusplus.c
+ *
+ * Several generators run side by side, one per lane,
+ * so that each step is a few vector instructions.
+ * The state is {s[word][lane]}.
+ **/
+#define NLanes_Xoshiro256 4
+
+qual_inline
+  uint64_t
+rotl_Xoshiro256 (uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+qual_inline
+  void
+step_Xoshiro256 (uint64_t s[4][NLanes_Xoshiro256],
+                 uint64_t out[NLanes_Xoshiro256])
+{
+  uint i;
+  for (i = 0; i < NLanes_Xoshiro256; ++i)
+    out[i] = rotl_Xoshiro256 (s[0][i] + s[3][i], 23) + s[0][i];
+
+  for (i = 0; i < NLanes_Xoshiro256; ++i) {
+    const uint64_t t = s[1][i] << 17;
+    s[2][i] ^= s[0][i];
+    s[3][i] ^= s[1][i];
+    s[1][i] ^= s[2][i];
+    s[0][i] ^= s[3][i];
+    s[2][i] ^= t;
+    s[3][i] = rotl_Xoshiro256 (s[3][i], 45);
+  }
+}
+
+/** Vigna's SplitMix64, used to spread a seed over the state.
+ * From: https://prng.di.unimi.it/splitmix64.c
+ **/
+qual_inline
+  uint64_t
+uint64_SplitMix64 (uint64_t* x)
+{
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
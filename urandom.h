@@ -7,6 +7,8 @@ typedef struct URandom URandom;
 struct URandom {
   uint32 state[17];
   uint32 salt;
+  /** Lanes of xoshiro256++ for the fill_*_URandom() functions.**/
+  uint64_t xoshiro[4][4];
   /* uint sys_pcidx; */
   /* uint sys_npcs; */
 };
@@ -26,10 +28,18 @@ bit_URandom (URandom* urandom);
 uint
 uint_URandom (URandom* urandom, uint n);
 void
+fill_uint_URandom (URandom* urandom, uint* a, zuint count, uint n);
+void
 shuffle_uints_URandom (URandom* urandom, uint* a, uint n);
+void
+fill_uint32_URandom (URandom* urandom, uint32* a, zuint n);
+void
+fill_real_URandom (URandom* urandom, real* a, zuint n);
 
 uint
 randommod_sysCx(uint n);
+void
+randommods_sysCx(uint* a, uint count, uint n);
 /* Implemented in syscx.c */
 Bool
 randomize_sysCx(void* p, uint size);